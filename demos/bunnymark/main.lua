@@ -29,6 +29,7 @@ dump(Canvas)
   Canvas.background(0)
 
   self.bunnies = {}
+  self.records = {}
   self.bank = Bank.new("assets/sheet.png", 26, 37)
   self.font = Font.default(15, 3)
   self.speed = 1.0
@@ -69,9 +70,16 @@ end
 function Main:render(_)
   Canvas.clear()
 
+  local records = self.records -- Reused across frames, to spare the garbage collector.
+  local count = 0
   for _, bunny in pairs(self.bunnies) do
-    bunny:render()
+    local offset = count * 3
+    records[offset + 1] = 0
+    records[offset + 2] = bunny.x
+    records[offset + 3] = bunny.y
+    count = count + 1
   end
+  self.bank:batch(records, count)
 
   self.font:write(string.format("FPS: %d", System.fps()), 0, 0, "left")
   self.font:write(string.format("#%d bunnies", #self.bunnies), Canvas.width(), 0, "right")
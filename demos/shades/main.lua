@@ -103,6 +103,15 @@ function Main:render(_)
       Canvas.process(i, 0, 1, Canvas.height())
       Canvas.process(Canvas.width() - 1 - i, 0, 1, Canvas.height())
     end
+  elseif self.mode == 2 then
+    Canvas.colormap(LEVELS)
+    Canvas.shade(LEVELS - 1, 0, -LEVELS / Canvas.height()) -- Shaded while blitting, fading toward the bottom.
+    for y = 0, Canvas.height() - 1, 8 do
+      for x = 0, Canvas.width() - 1, 8 do
+        self.bank:blit(0, x, y)
+      end
+    end
+    Canvas.shade()
   else
     local t = System.time()
     local index = math.tointeger((math.sin(t * 2.5) + 1) * 0.5 * (STEPS - 1))
@@ -71,25 +71,7 @@ function Camera:move_to(x, y)
   local map_x = math.tointeger(self.x) - self.center_x
   local map_y = math.tointeger(self.y) - self.center_y
 
-  if self.map_x == map_x and self.map_y == map_y then
-    return
-  end
-  self.map_x, self.map_y = map_x, map_y -- Track offsetted map position to track *real* changes.
-
-  local scale = self.scale
-  local cw, ch = self.bank:cell_width(), self.bank:cell_height()
-  local start_column = math.tointeger(map_x / cw)
-  local start_row = math.tointeger(map_y / ch)
-  local column_offset = -math.tointeger((map_x % cw) * scale)
-  local row_offset = -math.tointeger((map_y % ch) * scale)
-
-  if self.start_column ~= start_column or self.start_row ~= start_row then
-    self.start_column = start_column
-    self.start_row = start_row
-    self:prepare_()
-  end
-  self.column_offset = column_offset
-  self.row_offset = row_offset
+  self.map_x, self.map_y = map_x, map_y
 end
 
 function Camera:to_screen(x, y)
@@ -111,52 +93,21 @@ function Camera:pre_draw()
 end
 
 function Camera:draw()
-  local scale = self.scale
-
   Canvas.clipping(self.screen_x, self.screen_y, self.screen_width, self.screen_height)
 
-  local ox, oy = self.screen_x + self.column_offset, self.screen_y + self.row_offset
-  for _, v in ipairs(self.batch) do
-    local cell_id, cell_x, cell_y = table.unpack(v)
-    self.bank:blit(cell_id, cell_x + ox, cell_y + oy, scale, scale)
-  end
+  self.bank:tilemap(self.grid, self.map_x, self.map_y, self.columns, self.rows,
+    self.screen_x, self.screen_y, self.scale)
 end
 
 function Camera:post_draw()
   -- Override.
 end
 
-function Camera:prepare_()
-  local scale = self.scale
-  local cw, ch = self.bank:cell_width() * scale, self.bank:cell_height() * scale
-
-  local rows = math.min(self.grid:width() - self.start_row, self.rows + 1) -- We handle an additional row/column
-  local columns = math.min(self.grid:height() - self.start_column, self.columns + 1) -- for sub-tile scrolling
-
-  local batch = {}
-  local y = 0
-  local r = self.start_row
-  for _ = 1, rows do
-    local x = 0
-    local c = self.start_column
-    for _ = 1, columns do
-      local cell_id = self.grid:peek(c, r)
-      table.insert(batch, { math.tointeger(cell_id), x, y })
-      x = x + cw
-      c = c + 1
-    end
-    y = y + ch
-    r = r + 1
-  end
-  self.batch = batch
-end
-
 function Camera:__tostring()
-  return string.format("[%s] %.0f %0.f | %.0f %0.f | %0.f %0.f",
+  return string.format("[%s] %.0f %0.f | %.0f %0.f",
       self.id,
       self.x, self.y,
-      self.start_column, self.start_row,
-      self.column_offset, self.row_offset)
+      self.map_x, self.map_y)
 end
 
 return Camera
\ No newline at end of file
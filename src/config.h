@@ -51,7 +51,8 @@
 #undef  __DEBUG_SHADER_CALLS__
 #define __DEBUG_GARBAGE_COLLECTOR__
 #define __VM_USE_CUSTOM_TRACEBACK__
-#undef  __GL_MASK_SUPPORT__
+#define __GL_SIMD_KERNELS__
+#define __GL_SHEET_SPANS__
 
 // In release build, disable VM calls debug for faster execution.
 #ifdef RELEASE
@@ -50,6 +50,24 @@ static void on_parameter(Configuration_t *configuration, const char *key, const
     if (strcmp(key, "vertical-sync") == 0) {
         configuration->vertical_sync = strcmp(value, "true") == 0;
     } else
+    if (strcmp(key, "deferred") == 0) {
+        configuration->deferred = strcmp(value, "true") == 0;
+    } else
+    if (strcmp(key, "workers") == 0) {
+        configuration->workers = (size_t)strtoul(value, NULL, 0);
+    } else
+    if (strcmp(key, "transform-cache") == 0) {
+        configuration->transform_cache = (size_t)strtoul(value, NULL, 0);
+    } else
+    if (strcmp(key, "layers") == 0) {
+        configuration->layers = (size_t)strtoul(value, NULL, 0);
+    } else
+    if (strcmp(key, "atlas-size") == 0) {
+        configuration->atlas_size = (size_t)strtoul(value, NULL, 0);
+    } else
+    if (strcmp(key, "atlas-padding") == 0) {
+        configuration->atlas_padding = (size_t)strtoul(value, NULL, 0);
+    } else
     if (strcmp(key, "fps") == 0) {
         configuration->fps = (size_t)strtoul(value, NULL, 0);
         configuration->skippable_frames = configuration->fps / 5; // Keep synched. About 20% of the FPS amount.
@@ -161,6 +179,12 @@ void Configuration_load(Configuration_t *configuration, const char *data)
             .scale = 0,
             .fullscreen = false,
             .vertical_sync = false,
+            .deferred = false,
+            .workers = 1,
+            .transform_cache = 0,
+            .layers = 1,
+            .atlas_size = 0,
+            .atlas_padding = 1,
             .fps = 60,
             .skippable_frames = 3, // About 20% of the FPS amount.
             .fps_cap = -1, // No capping as a default. TODO: make it run-time configurable?
@@ -35,6 +35,12 @@ typedef struct _Configuration {
     size_t width, height, scale;
     bool fullscreen;  // TODO: rename to "windowed"?
     bool vertical_sync;
+    bool deferred; // Record the drawing operations and replay them (optimized) when presenting.
+    size_t workers; // Amount of threads the deferred replay is split into (implies `deferred` when greater than one).
+    size_t transform_cache; // Memory budget (in kilobytes) for the pre-transformed bank cells, `0` to disable it.
+    size_t layers; // Retained canvas layers, composited when presenting (a single one means drawing directly).
+    size_t atlas_size; // Side (in pixels) of the pages loaded images are packed into, `0` to disable packing.
+    size_t atlas_padding; // Border (in pixels) of index zero pixels around each packed image.
     size_t fps; // TODO: rename to "frequency"?
     size_t skippable_frames;
     size_t fps_cap;
@@ -128,6 +128,12 @@ bool Engine_initialize(Engine_t *engine, const char *base_path)
             .height = engine->configuration.height,
             .fullscreen = engine->configuration.fullscreen,
             .vertical_sync = engine->configuration.vertical_sync,
+            .deferred = engine->configuration.deferred,
+            .workers = engine->configuration.workers,
+            .transform_cache = engine->configuration.transform_cache,
+            .layers = engine->configuration.layers,
+            .atlas_size = engine->configuration.atlas_size,
+            .atlas_padding = engine->configuration.atlas_padding,
             .scale = engine->configuration.scale,
             .hide_cursor = engine->configuration.hide_cursor
         };
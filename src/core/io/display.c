@@ -40,6 +40,8 @@
   #define PIXEL_FORMAT    GL_RGBA
 #endif
 
+#define VRAM_UPLOAD_GAP     8 // Runs of changed rows closer than this are uploaded at once, to save on calls.
+
 typedef struct _Program_Data_t {
     const char *vertex_shader;
     const char *fragment_shader;
@@ -317,6 +319,24 @@ bool Display_initialize(Display_t *display, const Display_Configuration_t *confi
         return false;
     }
 
+    if (!GL_surface_track(&display->gl.buffer, true)) { // Present only the changed rows.
+        Log_write(LOG_LEVELS_WARNING, LOG_CONTEXT, "can't track canvas changes, presenting it whole");
+    }
+
+    if (configuration->layers > 1 && GL_context_layers(&display->gl, configuration->layers)) {
+        Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "canvas w/ %d layers", configuration->layers);
+    }
+
+    if (configuration->deferred || configuration->workers > 1) { // Bands are rasterized concurrently on replay.
+        GL_context_defer(&display->gl, true, configuration->workers);
+        Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "deferred rendering enabled w/ %d worker(s)", configuration->workers);
+    }
+
+    GL_cache_create(&display->cache, configuration->transform_cache * 1024);
+    GL_atlas_create(&display->atlas, configuration->atlas_size, configuration->atlas_size, configuration->atlas_padding);
+    GL_blends_create(&display->blends);
+    GL_colormaps_create(&display->colormaps);
+
     GL_palette_greyscale(&display->palette, GL_MAX_PALETTE_COLORS);
     Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "calculating greyscale palette of #%d entries", GL_MAX_PALETTE_COLORS);
 
@@ -401,6 +421,12 @@ void Display_terminate(Display_t *display)
 
     GL_context_delete(&display->gl);
 
+    GL_cache_delete(&display->cache); // Once the context is gone, no pending commands refer to the cache.
+    Log_write(LOG_LEVELS_INFO, LOG_CONTEXT, "atlas occupancy was %.1f%% over %d page(s)", GL_atlas_occupancy(&display->atlas) * 100.0f, arrlen(display->atlas.pages));
+    GL_atlas_delete(&display->atlas);
+    GL_blends_delete(&display->blends);
+    GL_colormaps_delete(&display->colormaps);
+
     glfwDestroyWindow(display->window);
     Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "window %p destroyed", display->window);
 
@@ -437,12 +463,42 @@ void Display_offset(Display_t *display, GL_Point_t offset)
 
 void Display_present(const Display_t *display)
 {
+    GL_context_compose(&display->gl); // Draw the pending commands, if any, and composite the layers.
+
     const GL_Surface_t *buffer = &display->gl.buffer;
     GL_Color_t *vram = display->vram;
 
-    GL_surface_to_rgba(buffer, &display->palette, vram);
+    GL_Bool_t *dirty = buffer->dirty;
+    if (!dirty) {
+        GL_surface_to_rgba(buffer, &display->palette, vram);
+
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, buffer->width, buffer->height, PIXEL_FORMAT, GL_UNSIGNED_BYTE, vram);
+    } else {
+        // Convert and upload the runs of rows changed since the last frame (the texture retains the other ones).
+        const size_t height = buffer->height;
+        for (size_t y = 0; y < height; ) {
+            if (!dirty[y]) {
+                ++y;
+                continue;
+            }
+
+            const size_t y0 = y;
+            size_t y1 = y;
+            for (size_t gap = 0; y < height && gap < VRAM_UPLOAD_GAP; ++y) {
+                if (dirty[y]) {
+                    dirty[y] = GL_BOOL_FALSE;
+                    y1 = y;
+                    gap = 0;
+                } else {
+                    ++gap;
+                }
+            }
 
-    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, buffer->width, buffer->height, PIXEL_FORMAT, GL_UNSIGNED_BYTE, vram);
+            GL_surface_rows_to_rgba(buffer, &display->palette, y0, y1, vram);
+
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, y0, buffer->width, y1 - y0 + 1, PIXEL_FORMAT, GL_UNSIGNED_BYTE, vram + y0 * buffer->width);
+        }
+    }
 
     // Add an offset x/y to implement shaking and similar effects.
     const GL_Quad_t *vram_destination = &display->vram_destination;
@@ -522,6 +578,14 @@ void Display_shader(Display_t *display, const char *effect)
 
 void Display_palette(Display_t *display, const GL_Palette_t *palette)
 {
+    GL_context_flush(&display->gl); // Pending commands have been issued with the current blending/shading tables.
+
     display->palette = *palette;
     Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "palette updated");
+
+    const GL_Surface_t *buffer = &display->gl.buffer;
+    GL_surface_touch(buffer, 0, (int)buffer->height - 1); // Every pixel could have changed color.
+
+    GL_blends_update(&display->blends, &display->palette);
+    GL_colormaps_update(&display->colormaps, &display->palette);
 }
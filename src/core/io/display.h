@@ -52,6 +52,12 @@ typedef struct _Display_Configuration_t {
     size_t width, height, scale;
     bool fullscreen;
     bool vertical_sync;
+    bool deferred;
+    size_t workers;
+    size_t transform_cache;
+    size_t layers;
+    size_t atlas_size;
+    size_t atlas_padding;
     bool hide_cursor;
 } Display_Configuration_t;
 
@@ -74,6 +80,11 @@ typedef struct _Display_t {
 
     GL_Palette_t palette;
     GL_Context_t gl;
+    GL_Cache_t cache;
+    GL_Atlas_t atlas; // Loaded images (of both surfaces and banks) are packed here.
+    GL_Blends_t blends;
+    GL_Colormaps_t colormaps;
+    const GL_Colormap_t *colormap; // The one used by `Canvas.shade()`, `NULL` until first selected.
 } Display_t;
 
 extern bool Display_initialize(Display_t *display, const Display_Configuration_t *configuration);
@@ -31,7 +31,9 @@
 #include <core/vm/modules/file.h>
 #include <core/vm/modules/math.h>
 #include <core/vm/modules/system.h>
+#include <core/vm/modules/spritelist.h>
 #include <core/vm/modules/surface.h>
+#include <core/vm/modules/tilemap.h>
 #include <core/vm/modules/timer.h>
 #include <libs/log.h>
 #include <libs/luax.h>
@@ -87,7 +89,9 @@ static int graphics_loader(lua_State *L)
         { "Bank", bank_loader },
         { "Canvas", canvas_loader },
         { "Font", font_loader },
+        { "SpriteList", spritelist_loader },
         { "Surface", surface_loader },
+        { "Tilemap", tilemap_loader },
         { NULL, NULL }
     };
     return create_module(L, classes);
@@ -25,6 +25,7 @@
 #include <config.h>
 #include <core/io/display.h>
 #include <core/vm/interpreter.h>
+#include <libs/imath.h>
 #include <libs/log.h>
 #include <libs/gl/gl.h>
 #include <libs/stb.h>
@@ -33,6 +34,7 @@
 #include "callbacks.h"
 
 #include <math.h>
+#include <stdlib.h>
 #include <string.h>
 
 #define LOG_CONTEXT "bank"
@@ -43,14 +45,22 @@ static int bank_new(lua_State *L);
 static int bank_gc(lua_State *L);
 static int bank_cell_width(lua_State *L);
 static int bank_cell_height(lua_State *L);
+static int bank_trimmed(lua_State *L);
 static int bank_blit(lua_State *L);
+static int bank_batch(lua_State *L);
+static int bank_collides(lua_State *L);
+static int bank_tilemap(lua_State *L);
 
 static const struct luaL_Reg _bank_functions[] = {
     { "new", bank_new },
     {"__gc", bank_gc },
     { "cell_width", bank_cell_width },
     { "cell_height", bank_cell_height },
+    { "trimmed", bank_trimmed },
     { "blit", bank_blit },
+    { "batch", bank_batch },
+    { "collides", bank_collides },
+    { "tilemap", bank_tilemap },
     { NULL, NULL }
 };
 
@@ -76,7 +86,7 @@ static int bank_new(lua_State *L)
     size_t cell_height = (size_t)lua_tointeger(L, 3);
 
     const File_System_t *file_system = (const File_System_t *)lua_touserdata(L, lua_upvalueindex(USERDATA_FILE_SYSTEM));
-    const Display_t *display = (const Display_t *)lua_touserdata(L, lua_upvalueindex(USERDATA_DISPLAY));
+    Display_t *display = (Display_t *)lua_touserdata(L, lua_upvalueindex(USERDATA_DISPLAY));
 
     GL_Sheet_t sheet;
 
@@ -87,9 +97,12 @@ static int bank_new(lua_State *L)
         if (chunk.type == FILE_SYSTEM_CHUNK_NULL) {
             return luaL_error(L, "can't load file `%s`", file);
         }
-        GL_sheet_fetch(&sheet, (GL_Image_t){ .width = chunk.var.image.width, .height = chunk.var.image.height, .data = chunk.var.image.pixels }, cell_width, cell_height, surface_callback_palette, (void *)&display->palette);
-        Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "sheet `%s` loaded", file);
+        bool packed = GL_sheet_pack(&sheet, &display->atlas, (GL_Image_t){ .width = chunk.var.image.width, .height = chunk.var.image.height, .data = chunk.var.image.pixels }, cell_width, cell_height, surface_callback_palette, (void *)&display->palette);
         FS_release(chunk);
+        if (!packed) {
+            return luaL_error(L, "can't load file `%s`", file);
+        }
+        Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "sheet `%s` loaded", file);
     } else
     if (type == LUA_TUSERDATA) {
         const Surface_Class_t *instance = (const Surface_Class_t *)lua_touserdata(L, 1);
@@ -101,7 +114,9 @@ static int bank_new(lua_State *L)
     Bank_Class_t *instance = (Bank_Class_t *)lua_newuserdata(L, sizeof(Bank_Class_t));
     *instance = (Bank_Class_t){
             .sheet = sheet,
-            .owned = type == LUA_TSTRING ? true : false
+            .owned = type == LUA_TSTRING ? true : false,
+            .masks = NULL,
+            .offsets = NULL
         };
     Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "bank allocated as %p", instance);
 
@@ -110,6 +125,26 @@ static int bank_new(lua_State *L)
     return 1;
 }
 
+static inline size_t cells_count(const GL_Sheet_t *sheet)
+{
+    return (sheet->atlas.width / sheet->size.width) * (sheet->atlas.height / sheet->size.height);
+}
+
+static void free_masks(Bank_Class_t *instance)
+{
+    if (!instance->masks) {
+        return;
+    }
+    for (size_t i = 0; i < cells_count(&instance->sheet); ++i) {
+        GL_mask_delete(&instance->masks[i]);
+    }
+    free(instance->masks);
+    free(instance->offsets);
+    instance->masks = NULL;
+    instance->offsets = NULL;
+    Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "bank %p masks deallocated", instance);
+}
+
 static int bank_gc(lua_State *L)
 {
     LUAX_SIGNATURE_BEGIN(L, 1)
@@ -117,8 +152,19 @@ static int bank_gc(lua_State *L)
     LUAX_SIGNATURE_END
     Bank_Class_t *instance = (Bank_Class_t *)lua_touserdata(L, 1);
 
+    Display_t *display = (Display_t *)lua_touserdata(L, lua_upvalueindex(USERDATA_DISPLAY));
+
+    GL_Context_t *context = &display->gl;
+    GL_context_sanitize(context, &instance->sheet.atlas);
+    Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "bank %p sanitized from context", instance);
+
+    GL_cache_sanitize(&display->cache, context, &instance->sheet);
+    Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "bank %p sanitized from cache", instance);
+
+    free_masks(instance);
+
     if (instance->owned) {
-        GL_sheet_delete(&instance->sheet);
+        GL_sheet_unpack(&instance->sheet, &display->atlas);
     } else {
         GL_sheet_detach(&instance->sheet);
     }
@@ -151,6 +197,32 @@ static int bank_cell_height(lua_State *L)
     return 1;
 }
 
+// Returns the opaque area of the cell as offset (relative to the cell top-left corner) and size. A fully transparent
+// cell has a zero-sized area.
+static int bank_trimmed(lua_State *L)
+{
+    LUAX_SIGNATURE_BEGIN(L, 2)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TUSERDATA)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+    LUAX_SIGNATURE_END
+    Bank_Class_t *instance = (Bank_Class_t *)lua_touserdata(L, 1);
+    lua_Integer cell_id = lua_tointeger(L, 2);
+
+    const size_t count = cells_count(&instance->sheet);
+    if (cell_id < 0 || (size_t)cell_id >= count) {
+        return luaL_error(L, "cell %d is out of range (0, %d)", (int)cell_id, (int)count);
+    }
+
+    const GL_Trim_t *trim = &instance->sheet.trims[cell_id];
+
+    lua_pushinteger(L, trim->offset.x);
+    lua_pushinteger(L, trim->offset.y);
+    lua_pushinteger(L, trim->area.width);
+    lua_pushinteger(L, trim->area.height);
+
+    return 4;
+}
+
 static int bank_blit4(lua_State *L)
 {
     LUAX_SIGNATURE_BEGIN(L, 4)
@@ -168,7 +240,7 @@ static int bank_blit4(lua_State *L)
 
     const GL_Context_t *context = &display->gl;
     const GL_Sheet_t *sheet = &instance->sheet;
-    GL_context_blit(context, &sheet->atlas, sheet->cells[cell_id], (GL_Point_t){ .x = x, .y = y });
+    GL_sheet_blit(context, sheet, cell_id, (GL_Point_t){ .x = x, .y = y });
 
     return 0;
 }
@@ -188,11 +260,15 @@ static int bank_blit5(lua_State *L)
     int y = lua_tointeger(L, 4);
     int rotation = lua_tointeger(L, 5);
 
-    const Display_t *display = (const Display_t *)lua_touserdata(L, lua_upvalueindex(USERDATA_DISPLAY));
+    Display_t *display = (Display_t *)lua_touserdata(L, lua_upvalueindex(USERDATA_DISPLAY));
 
     const GL_Context_t *context = &display->gl;
     const GL_Sheet_t *sheet = &instance->sheet;
-    GL_context_blit_sr(context, &sheet->atlas, sheet->cells[cell_id], (GL_Point_t){ .x = x, .y = y }, 1.0f, 1.0f, rotation, 0.5f, 0.5f);
+    if (instance->owned && display->cache.budget > 0) { // Attached surfaces can change, the cache would be stale.
+        GL_cache_blit_sr(&display->cache, context, sheet, cell_id, (GL_Point_t){ .x = x, .y = y }, 1.0f, 1.0f, rotation, 0.5f, 0.5f);
+    } else {
+        GL_sheet_blit_sr(context, sheet, cell_id, (GL_Point_t){ .x = x, .y = y }, 1.0f, 1.0f, rotation, 0.5f, 0.5f);
+    }
 
     return 0;
 }
@@ -218,7 +294,7 @@ static int bank_blit6(lua_State *L)
 
     const GL_Context_t *context = &display->gl;
     const GL_Sheet_t *sheet = &instance->sheet;
-    GL_context_blit_s(context, &sheet->atlas, sheet->cells[cell_id], (GL_Point_t){ .x = x, .y = y }, scale_x, scale_y);
+    GL_sheet_blit_s(context, sheet, cell_id, (GL_Point_t){ .x = x, .y = y }, scale_x, scale_y);
 
     return 0;
 }
@@ -242,11 +318,15 @@ static int bank_blit7(lua_State *L)
     float scale_y = lua_tonumber(L, 6);
     int rotation = lua_tointeger(L, 7);
 
-    const Display_t *display = (const Display_t *)lua_touserdata(L, lua_upvalueindex(USERDATA_DISPLAY));
+    Display_t *display = (Display_t *)lua_touserdata(L, lua_upvalueindex(USERDATA_DISPLAY));
 
     const GL_Context_t *context = &display->gl;
     const GL_Sheet_t *sheet = &instance->sheet;
-    GL_context_blit_sr(context, &sheet->atlas, sheet->cells[cell_id], (GL_Point_t){ .x = x, .y = y }, scale_x, scale_y, rotation, 0.5f, 0.5f);
+    if (instance->owned && display->cache.budget > 0) { // Attached surfaces can change, the cache would be stale.
+        GL_cache_blit_sr(&display->cache, context, sheet, cell_id, (GL_Point_t){ .x = x, .y = y }, scale_x, scale_y, rotation, 0.5f, 0.5f);
+    } else {
+        GL_sheet_blit_sr(context, sheet, cell_id, (GL_Point_t){ .x = x, .y = y }, scale_x, scale_y, rotation, 0.5f, 0.5f);
+    }
 
     return 0;
 }
@@ -274,11 +354,15 @@ static int bank_blit9(lua_State *L)
     float anchor_x = lua_tonumber(L, 8);
     float anchor_y = lua_tonumber(L, 9);
 
-    const Display_t *display = (const Display_t *)lua_touserdata(L, lua_upvalueindex(USERDATA_DISPLAY));
+    Display_t *display = (Display_t *)lua_touserdata(L, lua_upvalueindex(USERDATA_DISPLAY));
 
     const GL_Context_t *context = &display->gl;
     const GL_Sheet_t *sheet = &instance->sheet;
-    GL_context_blit_sr(context, &sheet->atlas, sheet->cells[cell_id], (GL_Point_t){ .x = x, .y = y }, scale_x, scale_y, rotation, anchor_x, anchor_y);
+    if (instance->owned && display->cache.budget > 0) { // Attached surfaces can change, the cache would be stale.
+        GL_cache_blit_sr(&display->cache, context, sheet, cell_id, (GL_Point_t){ .x = x, .y = y }, scale_x, scale_y, rotation, anchor_x, anchor_y);
+    } else {
+        GL_sheet_blit_sr(context, sheet, cell_id, (GL_Point_t){ .x = x, .y = y }, scale_x, scale_y, rotation, anchor_x, anchor_y);
+    }
 
     return 0;
 }
@@ -293,3 +377,369 @@ static int bank_blit(lua_State *L)
         LUAX_OVERLOAD_ARITY(9, bank_blit9)
     LUAX_OVERLOAD_END
 }
+
+#define BATCH_MAX_FIELDS    8
+
+static inline bool is_batch_layout(lua_Integer fields)
+{
+    return fields == 3 || fields == 4 || fields == 5 || fields == 6 || fields == 8;
+}
+
+// Each record is laid out as the arguments of the `blit()` overloads, i.e. `cell_id, x, y`, optionally followed by
+// `rotation`, `scale_x, scale_y`, `scale_x, scale_y, rotation` or `scale_x, scale_y, rotation, anchor_x, anchor_y`.
+// Records are read either from `data`, when not `NULL`, or from the table at index `idx` of the stack.
+static void batch(lua_State *L, int idx, Display_t *display, const Bank_Class_t *instance, const float *data, size_t count, size_t fields)
+{
+    const GL_Context_t *context = &display->gl;
+    const GL_Sheet_t *sheet = &instance->sheet;
+    GL_Cache_t *cache = instance->owned && display->cache.budget > 0 ? &display->cache : NULL; // As in `blit()`, attached surfaces aren't cached.
+    const float cells = (float)cells_count(sheet);
+
+    float fetched[BATCH_MAX_FIELDS];
+    for (size_t i = 0; i < count; ++i) {
+        const float *record = fetched;
+        if (data) {
+            record = data + i * fields;
+        } else {
+            for (size_t j = 0; j < fields; ++j) {
+                lua_rawgeti(L, idx, (lua_Integer)(i * fields + j + 1));
+                fetched[j] = (float)lua_tonumber(L, -1);
+                lua_pop(L, 1);
+            }
+        }
+
+        if (!(record[0] >= 0.0f && record[0] < cells)) { // Skip out-of-range ids (NaNs included), as `tilemap()` does.
+            continue;
+        }
+        const size_t cell_id = (size_t)record[0];
+        const GL_Point_t position = (GL_Point_t){ .x = (int)floorf(record[1]), .y = (int)floorf(record[2]) }; // Same as `lua_tointeger()`.
+
+        if (fields == 3) {
+            GL_sheet_blit(context, sheet, cell_id, position);
+        } else
+        if (fields == 5) {
+            GL_sheet_blit_s(context, sheet, cell_id, position, record[3], record[4]);
+        } else {
+            const float scale_x = fields == 4 ? 1.0f : record[3];
+            const float scale_y = fields == 4 ? 1.0f : record[4];
+            const int rotation = (int)(fields == 4 ? record[3] : record[5]);
+            const float anchor_x = fields == 8 ? record[6] : 0.5f;
+            const float anchor_y = fields == 8 ? record[7] : 0.5f;
+            if (cache) {
+                GL_cache_blit_sr(cache, context, sheet, cell_id, position, scale_x, scale_y, rotation, anchor_x, anchor_y);
+            } else {
+                GL_sheet_blit_sr(context, sheet, cell_id, position, scale_x, scale_y, rotation, anchor_x, anchor_y);
+            }
+        }
+    }
+}
+
+// The buffer is either a flat table of numbers or a (binary) string of native `float` values, as packed by
+// `string.pack("f", ...)`. It can be longer than `count` records (e.g. when reused across frames), the trailing
+// entries are ignored.
+static int batch_from(lua_State *L, size_t count, lua_Integer fields)
+{
+    const Bank_Class_t *instance = (const Bank_Class_t *)lua_touserdata(L, 1);
+    int type = lua_type(L, 2);
+
+    Display_t *display = (Display_t *)lua_touserdata(L, lua_upvalueindex(USERDATA_DISPLAY));
+
+    if (!is_batch_layout(fields)) {
+        return luaL_error(L, "invalid record size %d", (int)fields);
+    }
+
+    if (type == LUA_TSTRING) {
+        size_t size;
+        const char *data = lua_tolstring(L, 2, &size);
+        if (size / sizeof(float) / (size_t)fields < count) {
+            return luaL_error(L, "buffer size %d is too short for %d records", (int)size, (int)count);
+        }
+        batch(L, 2, display, instance, (const float *)data, count, (size_t)fields); // Lua strings are suitably aligned for any type.
+    } else
+    if (type == LUA_TTABLE) {
+        size_t length = lua_rawlen(L, 2);
+        if (length / (size_t)fields < count) {
+            return luaL_error(L, "table length %d is too short for %d records", (int)length, (int)count);
+        }
+        batch(L, 2, display, instance, NULL, count, (size_t)fields);
+    }
+
+    return 0;
+}
+
+static int bank_batch3(lua_State *L)
+{
+    LUAX_SIGNATURE_BEGIN(L, 3)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TUSERDATA)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TTABLE, LUA_TSTRING)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+    LUAX_SIGNATURE_END
+    lua_Integer count = lua_tointeger(L, 3);
+
+    return batch_from(L, count > 0 ? (size_t)count : 0, 3);
+}
+
+static int bank_batch4(lua_State *L)
+{
+    LUAX_SIGNATURE_BEGIN(L, 4)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TUSERDATA)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TTABLE, LUA_TSTRING)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+    LUAX_SIGNATURE_END
+    lua_Integer count = lua_tointeger(L, 3);
+    lua_Integer fields = lua_tointeger(L, 4);
+
+    return batch_from(L, count > 0 ? (size_t)count : 0, fields);
+}
+
+static int bank_batch(lua_State *L)
+{
+    LUAX_OVERLOAD_BEGIN(L)
+        LUAX_OVERLOAD_ARITY(3, bank_batch3)
+        LUAX_OVERLOAD_ARITY(4, bank_batch4)
+    LUAX_OVERLOAD_END
+}
+
+// Masks are built from the transparent indexes in effect when the bank is tested, and rebuilt when they change.
+// Trimmed borders are made of index zero pixels, so the (smaller) trimmed area is used only when it's transparent.
+static bool build_masks(Bank_Class_t *instance, const GL_Bool_t *transparent)
+{
+    if (instance->masks) {
+        if (memcmp(instance->transparent, transparent, sizeof(instance->transparent)) == 0) {
+            return true;
+        }
+        free_masks(instance);
+    }
+
+    const GL_Sheet_t *sheet = &instance->sheet;
+    const size_t count = cells_count(sheet);
+
+    GL_Mask_t *masks = malloc(count * sizeof(GL_Mask_t));
+    GL_Point_t *offsets = malloc(count * sizeof(GL_Point_t));
+    if (!masks || !offsets) {
+        free(masks);
+        free(offsets);
+        return false;
+    }
+
+    const bool trimmed = transparent[0];
+    for (size_t i = 0; i < count; ++i) {
+        const GL_Rectangle_t area = trimmed ? sheet->trims[i].area : sheet->cells[i];
+        offsets[i] = trimmed ? sheet->trims[i].offset : (GL_Point_t){ .x = 0, .y = 0 };
+        masks[i] = (GL_Mask_t){ 0 }; // Fully transparent cells have an empty mask, which never collides.
+        if (area.width == 0 || area.height == 0 || !GL_mask_create(&masks[i], area.width, area.height)) {
+            continue;
+        }
+        GL_mask_opaque(&masks[i], &sheet->atlas, area, transparent);
+    }
+
+    instance->masks = masks;
+    instance->offsets = offsets;
+    memcpy(instance->transparent, transparent, sizeof(instance->transparent));
+    Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "bank %p has %d masks", instance, count);
+
+    return true;
+}
+
+static int bank_collides(lua_State *L)
+{
+    LUAX_SIGNATURE_BEGIN(L, 8)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TUSERDATA)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TUSERDATA)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+    LUAX_SIGNATURE_END
+    Bank_Class_t *instance_a = (Bank_Class_t *)lua_touserdata(L, 1);
+    lua_Integer cell_id_a = lua_tointeger(L, 2);
+    int x_a = lua_tointeger(L, 3);
+    int y_a = lua_tointeger(L, 4);
+    Bank_Class_t *instance_b = (Bank_Class_t *)lua_touserdata(L, 5);
+    lua_Integer cell_id_b = lua_tointeger(L, 6);
+    int x_b = lua_tointeger(L, 7);
+    int y_b = lua_tointeger(L, 8);
+
+    const Display_t *display = (const Display_t *)lua_touserdata(L, lua_upvalueindex(USERDATA_DISPLAY));
+
+    if (cell_id_a < 0 || (size_t)cell_id_a >= cells_count(&instance_a->sheet)) {
+        return luaL_error(L, "cell %d is out of range (0, %d)", (int)cell_id_a, (int)cells_count(&instance_a->sheet));
+    }
+    if (cell_id_b < 0 || (size_t)cell_id_b >= cells_count(&instance_b->sheet)) {
+        return luaL_error(L, "cell %d is out of range (0, %d)", (int)cell_id_b, (int)cells_count(&instance_b->sheet));
+    }
+
+    const GL_Bool_t *transparent = display->gl.state.transparent;
+    if (!build_masks(instance_a, transparent) || !build_masks(instance_b, transparent)) {
+        return luaL_error(L, "can't allocate masks");
+    }
+
+    const GL_Point_t offset_a = instance_a->offsets[cell_id_a];
+    const GL_Point_t offset_b = instance_b->offsets[cell_id_b];
+    const bool result = GL_mask_overlap(&instance_a->masks[cell_id_a], (GL_Point_t){ .x = x_a + offset_a.x, .y = y_a + offset_a.y },
+        &instance_b->masks[cell_id_b], (GL_Point_t){ .x = x_b + offset_b.x, .y = y_b + offset_b.y });
+
+    lua_pushboolean(L, result);
+
+    return 1;
+}
+
+static inline int floor_div(int a, int b)
+{
+    return a >= 0 ? a / b : -((b - 1 - a) / b);
+}
+
+// Draw the `size` tiles wide window of the grid, whose top-left corner is at the `camera` map position (in pixels),
+// with the cells the grid values refer to. Only the tiles overlapping both the window and the clipping region are
+// visited, the partially visible ones are clipped by the latter (i.e. the caller is expected to clip to the window).
+// Out of range cell ids are skipped, so they can be used to mark the empty tiles.
+static void tilemap(const GL_Context_t *context, const GL_Sheet_t *sheet, const Grid_Class_t *grid, const int *remap, GL_Point_t camera, GL_Size_t size, GL_Point_t screen, float scale)
+{
+    const int cell_width = (int)sheet->size.width;
+    const int cell_height = (int)sheet->size.height;
+    const int count = (int)cells_count(sheet);
+
+    const GL_Quad_t *clipping_region = &context->state.clipping_region;
+    const int x0 = imax(screen.x, clipping_region->x0);
+    const int y0 = imax(screen.y, clipping_region->y0);
+    const int x1 = imin(screen.x + (int)((float)(size.width * cell_width) * scale + 0.5f), clipping_region->x1 + 1);
+    const int y1 = imin(screen.y + (int)((float)(size.height * cell_height) * scale + 0.5f), clipping_region->y1 + 1);
+    if (x0 >= x1 || y0 >= y1) {
+        return;
+    }
+
+    // Map the visible screen area back to the tiles, clamped to the grid.
+    const int column0 = imax(floor_div(camera.x + (int)floorf((float)(x0 - screen.x) / scale), cell_width), 0);
+    const int row0 = imax(floor_div(camera.y + (int)floorf((float)(y0 - screen.y) / scale), cell_height), 0);
+    const int column1 = imin(floor_div(camera.x + (int)ceilf((float)(x1 - screen.x) / scale) - 1, cell_width), (int)grid->width - 1);
+    const int row1 = imin(floor_div(camera.y + (int)ceilf((float)(y1 - screen.y) / scale) - 1, cell_height), (int)grid->height - 1);
+
+    const bool unscaled = scale == 1.0f;
+
+    const Cell_t *data = grid->data + row0 * grid->width;
+    for (int row = row0; row <= row1; ++row) {
+        const int y = screen.y + (int)floorf((float)(row * cell_height - camera.y) * scale);
+        for (int column = column0; column <= column1; ++column) {
+            int cell_id = (int)data[column];
+            if (cell_id < 0 || cell_id >= count) {
+                continue;
+            }
+            if (remap) {
+                cell_id = remap[cell_id];
+                if (cell_id < 0 || cell_id >= count) {
+                    continue;
+                }
+            }
+            const int x = screen.x + (int)floorf((float)(column * cell_width - camera.x) * scale);
+            if (unscaled) {
+                GL_sheet_blit(context, sheet, (size_t)cell_id, (GL_Point_t){ .x = x, .y = y });
+            } else {
+                GL_sheet_blit_s(context, sheet, (size_t)cell_id, (GL_Point_t){ .x = x, .y = y }, scale, scale);
+            }
+        }
+        data += grid->width;
+    }
+}
+
+static int bank_tilemap9(lua_State *L)
+{
+    LUAX_SIGNATURE_BEGIN(L, 9)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TUSERDATA)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TUSERDATA)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+    LUAX_SIGNATURE_END
+    const Bank_Class_t *instance = (const Bank_Class_t *)lua_touserdata(L, 1);
+    const Grid_Class_t *grid = (const Grid_Class_t *)lua_touserdata(L, 2);
+    int camera_x = lua_tointeger(L, 3);
+    int camera_y = lua_tointeger(L, 4);
+    size_t columns = (size_t)lua_tointeger(L, 5);
+    size_t rows = (size_t)lua_tointeger(L, 6);
+    int screen_x = lua_tointeger(L, 7);
+    int screen_y = lua_tointeger(L, 8);
+    float scale = lua_tonumber(L, 9);
+
+    if (!(scale > 0.0f)) {
+        return luaL_error(L, "scale %f must be positive", (double)scale);
+    }
+
+    const Display_t *display = (const Display_t *)lua_touserdata(L, lua_upvalueindex(USERDATA_DISPLAY));
+
+    tilemap(&display->gl, &instance->sheet, grid, NULL, (GL_Point_t){ .x = camera_x, .y = camera_y }, (GL_Size_t){ .width = columns, .height = rows },
+        (GL_Point_t){ .x = screen_x, .y = screen_y }, scale);
+
+    return 0;
+}
+
+// The table maps (some of the) cell ids to the ones to be drawn in their place, e.g. the current frame of an animated
+// tile. It is flattened once per call, so that the tiles loop doesn't touch the Lua state.
+static int bank_tilemap10(lua_State *L)
+{
+    LUAX_SIGNATURE_BEGIN(L, 10)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TUSERDATA)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TUSERDATA)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TTABLE)
+    LUAX_SIGNATURE_END
+    const Bank_Class_t *instance = (const Bank_Class_t *)lua_touserdata(L, 1);
+    const Grid_Class_t *grid = (const Grid_Class_t *)lua_touserdata(L, 2);
+    int camera_x = lua_tointeger(L, 3);
+    int camera_y = lua_tointeger(L, 4);
+    size_t columns = (size_t)lua_tointeger(L, 5);
+    size_t rows = (size_t)lua_tointeger(L, 6);
+    int screen_x = lua_tointeger(L, 7);
+    int screen_y = lua_tointeger(L, 8);
+    float scale = lua_tonumber(L, 9);
+
+    if (!(scale > 0.0f)) {
+        return luaL_error(L, "scale %f must be positive", (double)scale);
+    }
+
+    const Display_t *display = (const Display_t *)lua_touserdata(L, lua_upvalueindex(USERDATA_DISPLAY));
+
+    const size_t count = cells_count(&instance->sheet);
+    int *remap = malloc(count * sizeof(int));
+    if (!remap) {
+        return luaL_error(L, "can't allocate remapping table");
+    }
+    for (size_t i = 0; i < count; ++i) {
+        remap[i] = (int)i;
+    }
+    lua_pushnil(L);
+    while (lua_next(L, 10)) {
+        lua_Integer from = lua_tointeger(L, -2);
+        if (from >= 0 && (size_t)from < count) {
+            remap[from] = (int)lua_tointeger(L, -1);
+        }
+        lua_pop(L, 1);
+    }
+
+    tilemap(&display->gl, &instance->sheet, grid, remap, (GL_Point_t){ .x = camera_x, .y = camera_y }, (GL_Size_t){ .width = columns, .height = rows },
+        (GL_Point_t){ .x = screen_x, .y = screen_y }, scale);
+
+    free(remap);
+
+    return 0;
+}
+
+static int bank_tilemap(lua_State *L)
+{
+    LUAX_OVERLOAD_BEGIN(L)
+        LUAX_OVERLOAD_ARITY(9, bank_tilemap9)
+        LUAX_OVERLOAD_ARITY(10, bank_tilemap10)
+    LUAX_OVERLOAD_END
+}
@@ -37,10 +37,15 @@ void surface_callback_palette(void *user_data, GL_Surface_t *surface, const void
     const rgba_t *src = (const rgba_t *)data;
     GL_Pixel_t *dst = surface->data;
 
-    for (size_t i = surface->data_size; i; --i) {
-        rgba_t rgba = *(src++);
-        GL_Color_t color = (GL_Color_t){ .r = rgba.r, .g = rgba.g, .b = rgba.b, .a = rgba.a };
-        *(dst++) = GL_palette_find_nearest_color(palette, color);
+    const size_t skip = surface->stride - surface->width; // The source image rows aren't padded.
+
+    for (size_t i = surface->height; i; --i) {
+        for (size_t j = surface->width; j; --j) {
+            rgba_t rgba = *(src++);
+            GL_Color_t color = (GL_Color_t){ .r = rgba.r, .g = rgba.g, .b = rgba.b, .a = rgba.a };
+            *(dst++) = GL_palette_find_nearest_color(palette, color);
+        }
+        dst += skip;
     }
 }
 
@@ -55,8 +60,13 @@ void surface_callback_indexes(void *user_data, GL_Surface_t *surface, const void
 
     const uint32_t background = *src; // The top-left pixel color defines the background.
 
-    for (size_t i = surface->data_size; i; --i) {
-        uint32_t rgba = *(src++);
-        *(dst++) = rgba == background ? bg_index : fg_index;
+    const size_t skip = surface->stride - surface->width;
+
+    for (size_t i = surface->height; i; --i) {
+        for (size_t j = surface->width; j; --j) {
+            uint32_t rgba = *(src++);
+            *(dst++) = rgba == background ? bg_index : fg_index;
+        }
+        dst += skip;
     }
 }
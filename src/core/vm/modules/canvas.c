@@ -48,18 +48,20 @@ static int canvas_push(lua_State *L);
 static int canvas_pop(lua_State *L);
 static int canvas_reset(lua_State *L);
 static int canvas_surface(lua_State *L);
+static int canvas_layer(lua_State *L);
 static int canvas_palette(lua_State *L);
 static int canvas_background(lua_State *L);
 static int canvas_color(lua_State *L);
 static int canvas_pattern(lua_State *L);
 static int canvas_shift(lua_State *L);
 static int canvas_transparent(lua_State *L);
+static int canvas_blend(lua_State *L);
+static int canvas_colormap(lua_State *L);
+static int canvas_shade(lua_State *L);
 static int canvas_clipping(lua_State *L);
 static int canvas_offset(lua_State *L);
 static int canvas_shader(lua_State *L);
-#ifdef __GL_MASK_SUPPORT__
 static int canvas_mask(lua_State *L);
-#endif
 static int canvas_clear(lua_State *L);
 static int canvas_point(lua_State *L);
 static int canvas_hline(lua_State *L);
@@ -68,10 +70,13 @@ static int canvas_line(lua_State *L);
 static int canvas_polyline(lua_State *L);
 static int canvas_fill(lua_State *L);
 static int canvas_triangle(lua_State *L);
+static int canvas_textured_triangle(lua_State *L);
 static int canvas_rectangle(lua_State *L);
 static int canvas_circle(lua_State *L);
 static int canvas_peek(lua_State *L);
 static int canvas_poke(lua_State *L);
+static int canvas_read(lua_State *L);
+static int canvas_write(lua_State *L);
 static int canvas_process(lua_State *L);
 
 // TODO: color index is optional, if not present use the current (drawstate) pen color
@@ -85,19 +90,21 @@ static const struct luaL_Reg _canvas_functions[] = {
     { "pop", canvas_pop },
     { "reset", canvas_reset },
     { "surface", canvas_surface },
+    { "layer", canvas_layer },
     { "palette", canvas_palette },
     { "background", canvas_background },
     { "color", canvas_color },
     { "pattern", canvas_pattern },
     { "shift", canvas_shift },
     { "transparent", canvas_transparent },
+    { "blend", canvas_blend },
+    { "colormap", canvas_colormap },
+    { "shade", canvas_shade },
     { "clipping", canvas_clipping },
     { "offset", canvas_offset },
     { "shader", canvas_shader },
-    { "clear", canvas_clear },
-#ifdef __GL_MASK_SUPPORT__
     { "mask", canvas_mask },
-#endif
+    { "clear", canvas_clear },
     { "point", canvas_point },
     { "hline", canvas_hline },
     { "vline", canvas_vline },
@@ -105,10 +112,13 @@ static const struct luaL_Reg _canvas_functions[] = {
     { "polyline", canvas_polyline },
     { "fill", canvas_fill },
     { "triangle", canvas_triangle },
+    { "textured_triangle", canvas_textured_triangle },
     { "rectangle", canvas_rectangle },
     { "circle", canvas_circle },
     { "peek", canvas_peek },
     { "poke", canvas_poke },
+    { "read", canvas_read },
+    { "write", canvas_write },
     { "process", canvas_process },
     { NULL, NULL }
 };
@@ -251,6 +261,42 @@ static int canvas_surface(lua_State *L)
     LUAX_OVERLOAD_END
 }
 
+static int canvas_layer0(lua_State *L)
+{
+    LUAX_SIGNATURE_BEGIN(L, 0)
+    LUAX_SIGNATURE_END
+
+    const Display_t *display = (const Display_t *)lua_touserdata(L, lua_upvalueindex(USERDATA_DISPLAY));
+
+    const GL_Context_t *context = &display->gl;
+    lua_pushinteger(L, context->layer);
+
+    return 1;
+}
+
+static int canvas_layer1(lua_State *L)
+{
+    LUAX_SIGNATURE_BEGIN(L, 1)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+    LUAX_SIGNATURE_END
+    size_t index = (size_t)lua_tointeger(L, 1);
+
+    Display_t *display = (Display_t *)lua_touserdata(L, lua_upvalueindex(USERDATA_DISPLAY));
+
+    GL_Context_t *context = &display->gl;
+    GL_context_layer(context, index);
+
+    return 0;
+}
+
+static int canvas_layer(lua_State *L)
+{
+    LUAX_OVERLOAD_BEGIN(L)
+        LUAX_OVERLOAD_ARITY(0, canvas_layer0)
+        LUAX_OVERLOAD_ARITY(1, canvas_layer1)
+    LUAX_OVERLOAD_END
+}
+
 static int canvas_palette0(lua_State *L)
 {
     LUAX_SIGNATURE_BEGIN(L, 0)
@@ -517,6 +563,184 @@ static int canvas_transparent(lua_State *L)
     LUAX_OVERLOAD_END
 }
 
+static GL_Blend_Modes_t string_to_blend_mode(const char *id)
+{
+    if (strcmp(id, "add") == 0) {
+        return GL_BLEND_MODE_ADD;
+    } else
+    if (strcmp(id, "subtract") == 0) {
+        return GL_BLEND_MODE_SUBTRACT;
+    } else
+    if (strcmp(id, "multiply") == 0) {
+        return GL_BLEND_MODE_MULTIPLY;
+    } else
+    if (strcmp(id, "screen") == 0) {
+        return GL_BLEND_MODE_SCREEN;
+    }
+    return GL_BLEND_MODE_ALPHA;
+}
+
+static int canvas_blend0(lua_State *L)
+{
+    LUAX_SIGNATURE_BEGIN(L, 0)
+    LUAX_SIGNATURE_END
+
+    Display_t *display = (Display_t *)lua_touserdata(L, lua_upvalueindex(USERDATA_DISPLAY));
+
+    GL_Context_t *context = &display->gl;
+    GL_context_blending(context, NULL);
+
+    return 0;
+}
+
+static int canvas_blend1(lua_State *L)
+{
+    LUAX_SIGNATURE_BEGIN(L, 1)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TSTRING)
+    LUAX_SIGNATURE_END
+    const char *id = lua_tostring(L, 1);
+
+    Display_t *display = (Display_t *)lua_touserdata(L, lua_upvalueindex(USERDATA_DISPLAY));
+
+    GL_Blend_Modes_t mode = string_to_blend_mode(id);
+    float alpha = mode == GL_BLEND_MODE_ALPHA ? 0.5f : 1.0f; // Half translucency, or the full effect.
+
+    GL_Context_t *context = &display->gl;
+    GL_context_blending(context, GL_blends_fetch(&display->blends, &display->palette, mode, alpha));
+
+    return 0;
+}
+
+static int canvas_blend2(lua_State *L)
+{
+    LUAX_SIGNATURE_BEGIN(L, 2)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TSTRING)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+    LUAX_SIGNATURE_END
+    const char *id = lua_tostring(L, 1);
+    float alpha = (float)lua_tonumber(L, 2);
+
+    Display_t *display = (Display_t *)lua_touserdata(L, lua_upvalueindex(USERDATA_DISPLAY));
+
+    GL_Blend_Modes_t mode = string_to_blend_mode(id);
+
+    GL_Context_t *context = &display->gl;
+    GL_context_blending(context, GL_blends_fetch(&display->blends, &display->palette, mode, alpha));
+
+    return 0;
+}
+
+static int canvas_blend(lua_State *L)
+{
+    LUAX_OVERLOAD_BEGIN(L)
+        LUAX_OVERLOAD_ARITY(0, canvas_blend0)
+        LUAX_OVERLOAD_ARITY(1, canvas_blend1)
+        LUAX_OVERLOAD_ARITY(2, canvas_blend2)
+    LUAX_OVERLOAD_END
+}
+
+static int canvas_colormap1(lua_State *L)
+{
+    LUAX_SIGNATURE_BEGIN(L, 1)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+    LUAX_SIGNATURE_END
+    size_t levels = (size_t)lua_tointeger(L, 1);
+
+    Display_t *display = (Display_t *)lua_touserdata(L, lua_upvalueindex(USERDATA_DISPLAY));
+
+    display->colormap = GL_colormaps_fetch(&display->colormaps, &display->palette, levels, (GL_Color_t){ 0, 0, 0, 255 }); // Fade to black.
+
+    return 0;
+}
+
+static int canvas_colormap2(lua_State *L)
+{
+    LUAX_SIGNATURE_BEGIN(L, 2)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+    LUAX_SIGNATURE_END
+    size_t levels = (size_t)lua_tointeger(L, 1);
+    uint32_t argb = (uint32_t)lua_tointeger(L, 2);
+
+    Display_t *display = (Display_t *)lua_touserdata(L, lua_upvalueindex(USERDATA_DISPLAY));
+
+    display->colormap = GL_colormaps_fetch(&display->colormaps, &display->palette, levels, GL_palette_unpack_color(argb));
+
+    return 0;
+}
+
+static int canvas_colormap(lua_State *L)
+{
+    LUAX_OVERLOAD_BEGIN(L)
+        LUAX_OVERLOAD_ARITY(1, canvas_colormap1)
+        LUAX_OVERLOAD_ARITY(2, canvas_colormap2)
+    LUAX_OVERLOAD_END
+}
+
+static int canvas_shade0(lua_State *L)
+{
+    LUAX_SIGNATURE_BEGIN(L, 0)
+    LUAX_SIGNATURE_END
+
+    Display_t *display = (Display_t *)lua_touserdata(L, lua_upvalueindex(USERDATA_DISPLAY));
+
+    GL_Context_t *context = &display->gl;
+    GL_context_shading(context, NULL);
+
+    return 0;
+}
+
+static void shade(Display_t *display, float level, float dx, float dy)
+{
+    if (!display->colormap) { // Default to one level for each palette color, fading to black.
+        display->colormap = GL_colormaps_fetch(&display->colormaps, &display->palette, display->palette.count, (GL_Color_t){ 0, 0, 0, 255 });
+    }
+
+    GL_Context_t *context = &display->gl;
+    GL_context_shading(context, display->colormap ? &(GL_Shading_t){ .colormap = display->colormap, .level = level, .dx = dx, .dy = dy } : NULL);
+}
+
+static int canvas_shade1(lua_State *L)
+{
+    LUAX_SIGNATURE_BEGIN(L, 1)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+    LUAX_SIGNATURE_END
+    float level = (float)lua_tonumber(L, 1);
+
+    Display_t *display = (Display_t *)lua_touserdata(L, lua_upvalueindex(USERDATA_DISPLAY));
+
+    shade(display, level, 0.0f, 0.0f);
+
+    return 0;
+}
+
+static int canvas_shade3(lua_State *L)
+{
+    LUAX_SIGNATURE_BEGIN(L, 3)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+    LUAX_SIGNATURE_END
+    float level = (float)lua_tonumber(L, 1);
+    float dx = (float)lua_tonumber(L, 2);
+    float dy = (float)lua_tonumber(L, 3);
+
+    Display_t *display = (Display_t *)lua_touserdata(L, lua_upvalueindex(USERDATA_DISPLAY));
+
+    shade(display, level, dx, dy); // Gradients, for per-column (`dx`) or per-scanline (`dy`) shading.
+
+    return 0;
+}
+
+static int canvas_shade(lua_State *L)
+{
+    LUAX_OVERLOAD_BEGIN(L)
+        LUAX_OVERLOAD_ARITY(0, canvas_shade0)
+        LUAX_OVERLOAD_ARITY(1, canvas_shade1)
+        LUAX_OVERLOAD_ARITY(3, canvas_shade3)
+    LUAX_OVERLOAD_END
+}
+
 static int canvas_clipping0(lua_State *L)
 {
     LUAX_SIGNATURE_BEGIN(L, 0)
@@ -609,7 +833,6 @@ static int canvas_shader(lua_State *L)
     return 0;
 }
 
-#ifdef __GL_MASK_SUPPORT__
 static int canvas_mask0(lua_State *L)
 {
     LUAX_SIGNATURE_BEGIN(L, 0)
@@ -618,50 +841,68 @@ static int canvas_mask0(lua_State *L)
     Display_t *display = (Display_t *)lua_touserdata(L, lua_upvalueindex(USERDATA_DISPLAY));
 
     GL_Context_t *context = &display->gl;
-    GL_context_mask(context, NULL);
+    GL_context_mask(context, NULL, (GL_Point_t){ 0 });
 
     return 0;
 }
 
-static int canvas_mask1(lua_State *L)
+// The mask is (re)built into the surface instance, by setting the pixels whose index is greater than or equal to the
+// threshold. This is a one-time conversion, later changes to the surface won't affect the mask.
+static bool mask(Display_t *display, Surface_Class_t *instance, GL_Pixel_t threshold, GL_Point_t position)
 {
-    LUAX_SIGNATURE_BEGIN(L, 1)
-        LUAX_SIGNATURE_ARGUMENT(LUA_TUSERDATA, LUA_TNUMBER)
-    LUAX_SIGNATURE_END
-    int type = lua_type(L, 1);
+    GL_Context_t *context = &display->gl;
+    GL_context_flush(context); // Pending commands could be referring the (about to be changed) mask.
 
-    Display_t *display = (Display_t *)lua_touserdata(L, lua_upvalueindex(USERDATA_DISPLAY));
+    GL_Mask_t *stencil = &instance->mask;
+    if (!stencil->data) {
+        if (!GL_mask_create(stencil, instance->surface.width, instance->surface.height)) {
+            return false;
+        }
+        Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "mask %p created for surface %p", stencil, instance);
+    }
+    GL_mask_threshold(stencil, &instance->surface, threshold);
 
-    GL_Context_t *context = &display->gl;
-    GL_Mask_t mask = context->state.mask;
-    if (type == LUA_TUSERDATA) {
-        const Surface_Class_t *instance = (const Surface_Class_t *)lua_touserdata(L, 1);
+    GL_context_mask(context, stencil, position);
 
-        mask.stencil = &instance->surface;
-    } else
-    if (type == LUA_TNUMBER) {
-        GL_Pixel_t index = lua_tointeger(L, 1);
+    return true;
+}
+
+static int canvas_mask2(lua_State *L)
+{
+    LUAX_SIGNATURE_BEGIN(L, 2)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TUSERDATA)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+    LUAX_SIGNATURE_END
+    Surface_Class_t *instance = (Surface_Class_t *)lua_touserdata(L, 1);
+    GL_Pixel_t threshold = (GL_Pixel_t)lua_tointeger(L, 2);
+
+    Display_t *display = (Display_t *)lua_touserdata(L, lua_upvalueindex(USERDATA_DISPLAY));
 
-        mask.threshold = index;
+    if (!mask(display, instance, threshold, (GL_Point_t){ .x = 0, .y = 0 })) {
+        return luaL_error(L, "can't create mask");
     }
-    GL_context_mask(context, &mask);
 
     return 0;
 }
 
-static int canvas_mask2(lua_State *L)
+static int canvas_mask4(lua_State *L)
 {
-    LUAX_SIGNATURE_BEGIN(L, 2)
+    LUAX_SIGNATURE_BEGIN(L, 4)
         LUAX_SIGNATURE_ARGUMENT(LUA_TUSERDATA)
         LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
     LUAX_SIGNATURE_END
-    const Surface_Class_t *instance = (const Surface_Class_t *)lua_touserdata(L, 1);
-    GL_Pixel_t index = lua_tointeger(L, 2);
+    Surface_Class_t *instance = (Surface_Class_t *)lua_touserdata(L, 1);
+    GL_Pixel_t threshold = (GL_Pixel_t)lua_tointeger(L, 2);
+    int x = lua_tointeger(L, 3);
+    int y = lua_tointeger(L, 4);
 
     Display_t *display = (Display_t *)lua_touserdata(L, lua_upvalueindex(USERDATA_DISPLAY));
 
-    GL_Context_t *context = &display->gl;
-    GL_context_mask(context, &(GL_Mask_t){ &instance->surface, index });
+    if (!mask(display, instance, threshold, (GL_Point_t){ .x = x, .y = y })) {
+        return luaL_error(L, "can't create mask");
+    }
 
     return 0;
 }
@@ -670,11 +911,10 @@ static int canvas_mask(lua_State *L)
 {
     LUAX_OVERLOAD_BEGIN(L)
         LUAX_OVERLOAD_ARITY(0, canvas_mask0)
-        LUAX_OVERLOAD_ARITY(1, canvas_mask1)
         LUAX_OVERLOAD_ARITY(2, canvas_mask2)
+        LUAX_OVERLOAD_ARITY(4, canvas_mask4)
     LUAX_OVERLOAD_END
 }
-#endif
 
 static int canvas_clear(lua_State *L)
 {
@@ -890,6 +1130,48 @@ static int canvas_triangle(lua_State *L)
     return 0;
 }
 
+static int canvas_textured_triangle(lua_State *L)
+{
+    LUAX_SIGNATURE_BEGIN(L, 13)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TUSERDATA)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+    LUAX_SIGNATURE_END
+    const Surface_Class_t *instance = (const Surface_Class_t *)lua_touserdata(L, 1);
+    int x0 = lua_tointeger(L, 2);
+    int y0 = lua_tointeger(L, 3);
+    float u0 = lua_tonumber(L, 4);
+    float v0 = lua_tonumber(L, 5);
+    int x1 = lua_tointeger(L, 6);
+    int y1 = lua_tointeger(L, 7);
+    float u1 = lua_tonumber(L, 8);
+    float v1 = lua_tonumber(L, 9);
+    int x2 = lua_tointeger(L, 10);
+    int y2 = lua_tointeger(L, 11);
+    float u2 = lua_tonumber(L, 12);
+    float v2 = lua_tonumber(L, 13);
+
+    const Display_t *display = (const Display_t *)lua_touserdata(L, lua_upvalueindex(USERDATA_DISPLAY));
+
+    const GL_Context_t *context = &display->gl;
+    GL_primitive_textured_triangle(context, &instance->surface,
+        (GL_Vertex_t){ .x = x0, .y = y0, .u = u0, .v = v0 },
+        (GL_Vertex_t){ .x = x1, .y = y1, .u = u1, .v = v1 },
+        (GL_Vertex_t){ .x = x2, .y = y2, .u = u2, .v = v2 });
+
+    return 0;
+}
+
 static int canvas_rectangle(lua_State *L)
 {
     LUAX_SIGNATURE_BEGIN(L, 6)
@@ -985,8 +1267,10 @@ static int canvas_peek(lua_State *L)
     const Display_t *display = (const Display_t *)lua_touserdata(L, lua_upvalueindex(USERDATA_DISPLAY));
 
     const GL_Context_t *context = &display->gl;
+    GL_context_flush(context); // Pending commands could affect the pixel.
+
     const GL_Surface_t *surface = context->state.surface;
-    GL_Pixel_t index = surface->data[y * surface->width + x];
+    GL_Pixel_t index = surface->data[y * surface->stride + x];
 
     lua_pushinteger(L, index);
 
@@ -1009,8 +1293,78 @@ static int canvas_poke(lua_State *L)
     index %= display->palette.count;
 
     const GL_Context_t *context = &display->gl;
+    GL_context_flush(context); // Keep the drawing order.
+
     GL_Surface_t *surface = context->state.surface;
-    surface->data[y * surface->width + x] = index;
+    surface->data[y * surface->stride + x] = index;
+    GL_surface_touch(surface, y, y);
+
+    return 0;
+}
+
+// Bulk counterparts of `Canvas.peek()` and `Canvas.poke()`, the area pixels are transferred (one byte each, row by row)
+// from/to a string. Indexes are copied as-is, pixels outside the canvas are read as zero and never written.
+static int canvas_read(lua_State *L)
+{
+    LUAX_SIGNATURE_BEGIN(L, 4)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+    LUAX_SIGNATURE_END
+    int x = lua_tointeger(L, 1);
+    int y = lua_tointeger(L, 2);
+    lua_Integer width = lua_tointeger(L, 3);
+    lua_Integer height = lua_tointeger(L, 4);
+
+    if (width < 0 || height < 0) {
+        return luaL_error(L, "invalid %dx%d area", (int)width, (int)height);
+    }
+
+    const Display_t *display = (const Display_t *)lua_touserdata(L, lua_upvalueindex(USERDATA_DISPLAY));
+
+    const GL_Context_t *context = &display->gl;
+    GL_context_flush(context); // Pending commands could affect the pixels.
+
+    const size_t size = (size_t)width * (size_t)height * sizeof(GL_Pixel_t);
+    luaL_Buffer buffer;
+    GL_Pixel_t *pixels = (GL_Pixel_t *)luaL_buffinitsize(L, &buffer, size);
+    GL_surface_read(context->state.surface, (GL_Rectangle_t){ .x = x, .y = y, .width = (size_t)width, .height = (size_t)height }, pixels);
+    luaL_pushresultsize(&buffer, size);
+
+    return 1;
+}
+
+static int canvas_write(lua_State *L)
+{
+    LUAX_SIGNATURE_BEGIN(L, 5)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TSTRING)
+    LUAX_SIGNATURE_END
+    int x = lua_tointeger(L, 1);
+    int y = lua_tointeger(L, 2);
+    lua_Integer width = lua_tointeger(L, 3);
+    lua_Integer height = lua_tointeger(L, 4);
+    size_t length;
+    const char *bytes = lua_tolstring(L, 5, &length);
+
+    if (width < 0 || height < 0) {
+        return luaL_error(L, "invalid %dx%d area", (int)width, (int)height);
+    }
+
+    if (length < (size_t)width * (size_t)height * sizeof(GL_Pixel_t)) {
+        return luaL_error(L, "%d bytes are too few for a %dx%d area", (int)length, (int)width, (int)height);
+    }
+
+    const Display_t *display = (const Display_t *)lua_touserdata(L, lua_upvalueindex(USERDATA_DISPLAY));
+
+    const GL_Context_t *context = &display->gl;
+    GL_context_flush(context); // Keep the drawing order.
+
+    GL_surface_write(context->state.surface, (GL_Rectangle_t){ .x = x, .y = y, .width = (size_t)width, .height = (size_t)height }, (const GL_Pixel_t *)bytes);
 
     return 0;
 }
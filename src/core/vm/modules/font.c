@@ -226,6 +226,12 @@ static int font_gc(lua_State *L)
     LUAX_SIGNATURE_END
     Font_Class_t *instance = (Font_Class_t *)lua_touserdata(L, 1);
 
+    Display_t *display = (Display_t *)lua_touserdata(L, lua_upvalueindex(USERDATA_DISPLAY));
+
+    GL_Context_t *context = &display->gl;
+    GL_context_sanitize(context, &instance->sheet.atlas);
+    Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "font %p sanitized from context", instance);
+
     if (instance->surface == LUAX_REFERENCE_NIL) {
         GL_sheet_delete(&instance->sheet);
     } else {
@@ -299,7 +305,7 @@ static int font_write5(lua_State *L)
         if (*ptr < ' ') {
             continue;
         }
-        GL_context_blit(context, &sheet->atlas, sheet->cells[*ptr - ' '], (GL_Point_t){ .x = dx, .y = dy });
+        GL_sheet_blit(context, sheet, *ptr - ' ', (GL_Point_t){ .x = dx, .y = dy });
         dx += dw;
     }
 
@@ -346,7 +352,7 @@ static int font_write6(lua_State *L)
         if (*ptr < ' ') {
             continue;
         }
-        GL_context_blit_s(context, &sheet->atlas, sheet->cells[*ptr - ' '], (GL_Point_t){ .x = dx, .y = dy }, scale, scale);
+        GL_sheet_blit_s(context, sheet, *ptr - ' ', (GL_Point_t){ .x = dx, .y = dy }, scale, scale);
         dx += dw;
     }
 
@@ -395,7 +401,7 @@ static int font_write7(lua_State *L)
         if (*ptr < ' ') {
             continue;
         }
-        GL_context_blit_s(context, &sheet->atlas, sheet->cells[*ptr - ' '], (GL_Point_t){ .x = dx, .y = dy }, scale_x, scale_y);
+        GL_sheet_blit_s(context, sheet, *ptr - ' ', (GL_Point_t){ .x = dx, .y = dy }, scale_x, scale_y);
         dx += dw;
     }
 
@@ -127,7 +127,8 @@ static int grid_new(lua_State *L)
             .width = width,
             .height = height,
             .data = data,
-            .data_size = data_size
+            .data_size = data_size,
+            .generation = 0
         };
 
     Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "grid %p allocated", instance);
@@ -209,6 +210,8 @@ static int grid_fill(lua_State *L)
         }
     }
 
+    instance->generation += 1;
+
     return 0;
 }
 
@@ -260,6 +263,8 @@ static int grid_stride(lua_State *L)
         }
     }
 
+    instance->generation += 1;
+
     return 0;
 }
 
@@ -311,6 +316,7 @@ static int grid_poke(lua_State *L)
 #endif
 
     instance->data[row * instance->width + column] = value;
+    instance->generation += 1;
 
     return 0;
 }
@@ -376,5 +382,7 @@ static int grid_process(lua_State *L)
         }
     }
 
+    instance->generation += 1;
+
     return 0;
 }
@@ -0,0 +1,383 @@
+/*
+ * Copyright (c) 2019-2020 by Marco Lizza (marco.lizza@gmail.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+#include "spritelist.h"
+
+#include <config.h>
+#include <core/io/display.h>
+#include <core/vm/interpreter.h>
+#include <libs/log.h>
+#include <libs/gl/gl.h>
+
+#include "udt.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LOG_CONTEXT "spritelist"
+
+#define SPRITELIST_MT   "Tofu_SpriteList_mt"
+
+static int spritelist_new(lua_State *L);
+static int spritelist_gc(lua_State *L);
+static int spritelist_size(lua_State *L);
+static int spritelist_clear(lua_State *L);
+static int spritelist_add(lua_State *L);
+static int spritelist_set(lua_State *L);
+static int spritelist_move(lua_State *L);
+static int spritelist_draw(lua_State *L);
+
+static const struct luaL_Reg _spritelist_functions[] = {
+    { "new", spritelist_new },
+    {"__gc", spritelist_gc },
+    { "size", spritelist_size },
+    { "clear", spritelist_clear },
+    { "add", spritelist_add },
+    { "set", spritelist_set },
+    { "move", spritelist_move },
+    { "draw", spritelist_draw },
+    { NULL, NULL }
+};
+
+static const luaX_Const _spritelist_constants[] = {
+    { NULL }
+};
+
+int spritelist_loader(lua_State *L)
+{
+    int nup = luaX_pushupvalues(L);
+    return luaX_newmodule(L, NULL, _spritelist_functions, _spritelist_constants, nup, SPRITELIST_MT);
+}
+
+// All the arrays are carved from a single block, reallocated (and copied) as a whole when growing.
+static bool reserve(SpriteList_Class_t *list, size_t capacity)
+{
+    if (capacity <= list->capacity) {
+        return true;
+    }
+
+    void *memory = malloc(capacity * (sizeof(size_t) + sizeof(float) * 3 + sizeof(uint32_t) * 3));
+    if (!memory) {
+        return false;
+    }
+
+    size_t *cells = (size_t *)memory; // Widest type first, to keep all the arrays aligned.
+    float *xs = (float *)(cells + capacity);
+    float *ys = xs + capacity;
+    float *depths = ys + capacity;
+    uint32_t *keys = (uint32_t *)(depths + capacity);
+    uint32_t *order = keys + capacity;
+    uint32_t *swap = order + capacity;
+
+    if (list->memory) {
+        memcpy(cells, list->cells, sizeof(size_t) * list->count);
+        memcpy(xs, list->xs, sizeof(float) * list->count);
+        memcpy(ys, list->ys, sizeof(float) * list->count);
+        memcpy(depths, list->depths, sizeof(float) * list->count);
+        free(list->memory);
+    }
+
+    list->memory = memory;
+    list->capacity = capacity;
+    list->cells = cells;
+    list->xs = xs;
+    list->ys = ys;
+    list->depths = depths;
+    list->keys = keys;
+    list->order = order;
+    list->swap = swap;
+
+    return true;
+}
+
+static int create(lua_State *L, size_t capacity)
+{
+    const Bank_Class_t *bank = (const Bank_Class_t *)lua_touserdata(L, 1);
+
+    SpriteList_Class_t list = (SpriteList_Class_t){
+            .bank = bank,
+            .memory = NULL,
+            .count = 0,
+            .capacity = 0
+        };
+    if (capacity > 0 && !reserve(&list, capacity)) {
+        return luaL_error(L, "can't allocate %d sprites", (int)capacity);
+    }
+
+    SpriteList_Class_t *instance = (SpriteList_Class_t *)lua_newuserdata(L, sizeof(SpriteList_Class_t));
+    *instance = list;
+    instance->bank_reference = luaX_ref(L, 1); // Track the bank as a reference to prevent garbage collection.
+    Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "sprite-list allocated as %p w/ capacity %d", instance, (int)capacity);
+
+    luaL_setmetatable(L, SPRITELIST_MT);
+
+    return 1;
+}
+
+static int spritelist_new1(lua_State *L)
+{
+    LUAX_SIGNATURE_BEGIN(L, 1)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TUSERDATA)
+    LUAX_SIGNATURE_END
+
+    return create(L, 0);
+}
+
+static int spritelist_new2(lua_State *L)
+{
+    LUAX_SIGNATURE_BEGIN(L, 2)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TUSERDATA)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+    LUAX_SIGNATURE_END
+    size_t capacity = (size_t)lua_tointeger(L, 2);
+
+    return create(L, capacity);
+}
+
+static int spritelist_new(lua_State *L)
+{
+    LUAX_OVERLOAD_BEGIN(L)
+        LUAX_OVERLOAD_ARITY(1, spritelist_new1)
+        LUAX_OVERLOAD_ARITY(2, spritelist_new2)
+    LUAX_OVERLOAD_END
+}
+
+static int spritelist_gc(lua_State *L)
+{
+    LUAX_SIGNATURE_BEGIN(L, 1)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TUSERDATA)
+    LUAX_SIGNATURE_END
+    SpriteList_Class_t *instance = (SpriteList_Class_t *)lua_touserdata(L, 1);
+
+    free(instance->memory);
+    Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "sprite-list %p arrays deallocated", instance);
+
+    luaX_unref(L, instance->bank_reference);
+
+    Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "sprite-list %p finalized", instance);
+
+    return 0;
+}
+
+static int spritelist_size(lua_State *L)
+{
+    LUAX_SIGNATURE_BEGIN(L, 1)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TUSERDATA)
+    LUAX_SIGNATURE_END
+    const SpriteList_Class_t *instance = (const SpriteList_Class_t *)lua_touserdata(L, 1);
+
+    lua_pushinteger(L, instance->count);
+
+    return 1;
+}
+
+static int spritelist_clear(lua_State *L)
+{
+    LUAX_SIGNATURE_BEGIN(L, 1)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TUSERDATA)
+    LUAX_SIGNATURE_END
+    SpriteList_Class_t *instance = (SpriteList_Class_t *)lua_touserdata(L, 1);
+
+    instance->count = 0; // Keep the arrays, they will be reused.
+
+    return 0;
+}
+
+// Returns the (zero-based) index of the sprite, to be used with `set()` and `move()`.
+static int spritelist_add(lua_State *L)
+{
+    LUAX_SIGNATURE_BEGIN(L, 5)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TUSERDATA)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+    LUAX_SIGNATURE_END
+    SpriteList_Class_t *instance = (SpriteList_Class_t *)lua_touserdata(L, 1);
+    size_t cell_id = (size_t)lua_tointeger(L, 2);
+    float x = lua_tonumber(L, 3);
+    float y = lua_tonumber(L, 4);
+    float depth = lua_tonumber(L, 5);
+
+    if (instance->count == instance->capacity) {
+        size_t capacity = instance->capacity > 0 ? instance->capacity * 2 : 64;
+        if (!reserve(instance, capacity)) {
+            return luaL_error(L, "can't allocate %d sprites", (int)capacity);
+        }
+    }
+
+    const size_t index = instance->count++;
+    instance->cells[index] = cell_id;
+    instance->xs[index] = x;
+    instance->ys[index] = y;
+    instance->depths[index] = depth;
+
+    lua_pushinteger(L, index);
+
+    return 1;
+}
+
+static int spritelist_set(lua_State *L)
+{
+    LUAX_SIGNATURE_BEGIN(L, 6)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TUSERDATA)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+    LUAX_SIGNATURE_END
+    SpriteList_Class_t *instance = (SpriteList_Class_t *)lua_touserdata(L, 1);
+    size_t index = (size_t)lua_tointeger(L, 2);
+    size_t cell_id = (size_t)lua_tointeger(L, 3);
+    float x = lua_tonumber(L, 4);
+    float y = lua_tonumber(L, 5);
+    float depth = lua_tonumber(L, 6);
+
+    if (index >= instance->count) {
+        return luaL_error(L, "sprite %d is out of range (0, %d)", (int)index, (int)instance->count);
+    }
+
+    instance->cells[index] = cell_id;
+    instance->xs[index] = x;
+    instance->ys[index] = y;
+    instance->depths[index] = depth;
+
+    return 0;
+}
+
+static int spritelist_move(lua_State *L)
+{
+    LUAX_SIGNATURE_BEGIN(L, 4)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TUSERDATA)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+    LUAX_SIGNATURE_END
+    SpriteList_Class_t *instance = (SpriteList_Class_t *)lua_touserdata(L, 1);
+    size_t index = (size_t)lua_tointeger(L, 2);
+    float x = lua_tonumber(L, 3);
+    float y = lua_tonumber(L, 4);
+
+    if (index >= instance->count) {
+        return luaL_error(L, "sprite %d is out of range (0, %d)", (int)index, (int)instance->count);
+    }
+
+    instance->xs[index] = x;
+    instance->ys[index] = y;
+
+    return 0;
+}
+
+// Maps the float bits to an unsigned integer with the same ordering, i.e. flip all the bits of the negative values
+// (to reverse their ordering) and just the sign of the positive ones (to place them after the negative ones).
+static inline uint32_t depth_to_key(float depth)
+{
+    uint32_t bits;
+    memcpy(&bits, &depth, sizeof(uint32_t));
+    return bits ^ ((bits & 0x80000000) ? 0xFFFFFFFF : 0x80000000);
+}
+
+// Least-significant-digit radix sort of the sprites indexes, one byte per pass. Being stable, sprites at the same
+// depth are drawn in insertion order. Passes where all the keys share the same byte are skipped, which is the
+// common case for small integer depths.
+static uint32_t *sort(uint32_t *order, uint32_t *swap, const uint32_t *keys, size_t count)
+{
+    for (int shift = 0; shift < 32; shift += 8) {
+        size_t offsets[256] = { 0 };
+        for (size_t i = 0; i < count; ++i) {
+            offsets[(keys[order[i]] >> shift) & 0xFF] += 1;
+        }
+        if (offsets[(keys[order[0]] >> shift) & 0xFF] == count) {
+            continue;
+        }
+
+        size_t offset = 0;
+        for (size_t i = 0; i < 256; ++i) {
+            size_t amount = offsets[i];
+            offsets[i] = offset;
+            offset += amount;
+        }
+
+        for (size_t i = 0; i < count; ++i) {
+            uint32_t index = order[i];
+            swap[offsets[(keys[index] >> shift) & 0xFF]++] = index;
+        }
+
+        uint32_t *temporary = order;
+        order = swap;
+        swap = temporary;
+    }
+    return order;
+}
+
+// Sprites lying completely outside the clipping region are culled before sorting, then the remaining ones are
+// drawn back to front (i.e. by increasing depth).
+static void draw(SpriteList_Class_t *list, const GL_Context_t *context)
+{
+    const GL_Sheet_t *sheet = &list->bank->sheet;
+    const int cell_width = (int)sheet->size.width;
+    const int cell_height = (int)sheet->size.height;
+    const size_t cells = (sheet->atlas.width / sheet->size.width) * (sheet->atlas.height / sheet->size.height);
+
+    const GL_Quad_t *clipping_region = &context->state.clipping_region;
+
+    size_t count = 0;
+    for (size_t i = 0; i < list->count; ++i) {
+        if (list->cells[i] >= cells) {
+            continue;
+        }
+        const int x = (int)floorf(list->xs[i]);
+        const int y = (int)floorf(list->ys[i]);
+        if (x + cell_width <= clipping_region->x0 || x > clipping_region->x1
+            || y + cell_height <= clipping_region->y0 || y > clipping_region->y1) {
+            continue;
+        }
+        list->keys[i] = depth_to_key(list->depths[i]);
+        list->order[count++] = (uint32_t)i;
+    }
+    if (count == 0) {
+        return;
+    }
+
+    const uint32_t *order = sort(list->order, list->swap, list->keys, count);
+
+    for (size_t i = 0; i < count; ++i) {
+        const uint32_t index = order[i];
+        GL_sheet_blit(context, sheet, list->cells[index], (GL_Point_t){ .x = (int)floorf(list->xs[index]), .y = (int)floorf(list->ys[index]) });
+    }
+}
+
+static int spritelist_draw(lua_State *L)
+{
+    LUAX_SIGNATURE_BEGIN(L, 1)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TUSERDATA)
+    LUAX_SIGNATURE_END
+    SpriteList_Class_t *instance = (SpriteList_Class_t *)lua_touserdata(L, 1);
+
+    const Display_t *display = (const Display_t *)lua_touserdata(L, lua_upvalueindex(USERDATA_DISPLAY));
+
+    draw(instance, &display->gl);
+
+    return 0;
+}
@@ -40,11 +40,15 @@
 
 static int surface_new(lua_State *L);
 static int surface_gc(lua_State *L);
+static int surface_view(lua_State *L);
 static int surface_width(lua_State *L);
 static int surface_height(lua_State *L);
 static int surface_grab(lua_State *L);
+static int surface_read(lua_State *L);
+static int surface_write(lua_State *L);
 static int surface_blit(lua_State *L);
 static int surface_xform(lua_State *L);
+static int surface_quad(lua_State *L);
 static int surface_offset(lua_State *L);
 static int surface_matrix(lua_State *L);
 static int surface_clamp(lua_State *L);
@@ -53,11 +57,15 @@ static int surface_table(lua_State *L);
 static const struct luaL_Reg _surface_functions[] = {
     { "new", surface_new },
     {"__gc", surface_gc },
+    { "view", surface_view },
     { "width", surface_width },
     { "height", surface_height },
     { "grab", surface_grab },
+    { "read", surface_read },
+    { "write", surface_write },
     { "blit", surface_blit },
     { "xform", surface_xform },
+    { "quad", surface_quad },
     { "offset", surface_offset },
     { "matrix", surface_matrix },
     { "clamp", surface_clamp },
@@ -113,16 +121,19 @@ static int surface_new1(lua_State *L)
     const char *file = lua_tostring(L, 1);
 
     const File_System_t *file_system = (const File_System_t *)lua_touserdata(L, lua_upvalueindex(USERDATA_FILE_SYSTEM));
-    const Display_t *display = (const Display_t *)lua_touserdata(L, lua_upvalueindex(USERDATA_DISPLAY));
+    Display_t *display = (Display_t *)lua_touserdata(L, lua_upvalueindex(USERDATA_DISPLAY));
 
     File_System_Chunk_t chunk = FS_load(file_system, file, FILE_SYSTEM_CHUNK_IMAGE);
     if (chunk.type == FILE_SYSTEM_CHUNK_NULL) {
         return luaL_error(L, "can't load file `%s`", file);
     }
     GL_Surface_t surface;
-    GL_surface_fetch(&surface, (GL_Image_t){ .width = chunk.var.image.width, .height = chunk.var.image.height, .data = chunk.var.image.pixels }, surface_callback_palette, (void *)&display->palette);
-    Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "surface `%s` loaded", file);
+    bool packed = GL_atlas_fetch(&display->atlas, &surface, (GL_Image_t){ .width = chunk.var.image.width, .height = chunk.var.image.height, .data = chunk.var.image.pixels }, surface_callback_palette, (void *)&display->palette);
     FS_release(chunk);
+    if (!packed) {
+        return luaL_error(L, "can't load file `%s`", file);
+    }
+    Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "surface `%s` loaded", file);
 
     Surface_Class_t *instance = (Surface_Class_t *)lua_newuserdata(L, sizeof(Surface_Class_t));
     *instance = (Surface_Class_t){
@@ -135,7 +146,9 @@ static int surface_new1(lua_State *L)
                     },
                     .clamp = GL_XFORM_CLAMP_REPEAT,
                     .table = NULL
-                }
+                },
+            .mask = (GL_Mask_t){ 0 },
+            .packed = true
         };
     Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "surface allocated as %p", instance);
 
@@ -168,7 +181,8 @@ static int surface_new2(lua_State *L)
                     },
                     .clamp = GL_XFORM_CLAMP_REPEAT,
                     .table = NULL
-                }
+                },
+            .mask = (GL_Mask_t){ 0 }
         };
     Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "surface allocated as %p", instance);
 
@@ -185,6 +199,52 @@ static int surface_new(lua_State *L)
     LUAX_OVERLOAD_END
 }
 
+// Views share the pixels of the parent surface, which is kept alive (by the means of the user-value) as long as the
+// view is. They can be used both as drawing target and as source, without any copy.
+static int surface_view(lua_State *L)
+{
+    LUAX_SIGNATURE_BEGIN(L, 5)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TUSERDATA)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+    LUAX_SIGNATURE_END
+    const Surface_Class_t *parent = (const Surface_Class_t *)lua_touserdata(L, 1);
+    int x = lua_tointeger(L, 2);
+    int y = lua_tointeger(L, 3);
+    size_t width = (size_t)lua_tointeger(L, 4);
+    size_t height = (size_t)lua_tointeger(L, 5);
+
+    GL_Surface_t surface;
+    if (!GL_surface_view(&surface, &parent->surface, (GL_Rectangle_t){ .x = x, .y = y, .width = width, .height = height })) {
+        return luaL_error(L, "can't create view <%d, %d, %d, %d> of surface %p", x, y, (int)width, (int)height, parent);
+    }
+
+    Surface_Class_t *instance = (Surface_Class_t *)lua_newuserdata(L, sizeof(Surface_Class_t));
+    *instance = (Surface_Class_t){
+            .surface = surface,
+            .xform = (GL_XForm_t){
+                    .registers = {
+                        0.0f, 0.0f, // No offset
+                        1.0f, 0.0f, 1.0f, 0.0f, // Identity matrix.
+                        0.0f, 0.0f, // No offset
+                    },
+                    .clamp = GL_XFORM_CLAMP_REPEAT,
+                    .table = NULL
+                },
+            .mask = (GL_Mask_t){ 0 }
+        };
+    Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "view %p allocated on surface %p", instance, parent);
+
+    lua_pushvalue(L, 1);
+    lua_setuservalue(L, -2); // Anchor the parent surface.
+
+    luaL_setmetatable(L, SURFACE_MT);
+
+    return 1;
+}
+
 static int surface_gc(lua_State *L)
 {
     LUAX_SIGNATURE_BEGIN(L, 1)
@@ -203,7 +263,17 @@ static int surface_gc(lua_State *L)
         Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "scan-line table %p deallocated", instance->xform.table);
     }
 
-    GL_surface_delete(&instance->surface);
+    if (instance->mask.data) {
+        GL_context_sanitize_mask(context, &instance->mask);
+        GL_mask_delete(&instance->mask);
+        Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "mask %p deallocated", &instance->mask);
+    }
+
+    if (instance->packed) {
+        GL_atlas_release(&display->atlas, &instance->surface);
+    } else {
+        GL_surface_delete(&instance->surface);
+    }
     Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "surface %p finalized", instance);
 
     return 0;
@@ -248,6 +318,76 @@ static int surface_grab(lua_State *L)
     return 0;
 }
 
+// See `Canvas.read()` and `Canvas.write()`.
+static int surface_read(lua_State *L)
+{
+    LUAX_SIGNATURE_BEGIN(L, 5)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TUSERDATA)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+    LUAX_SIGNATURE_END
+    const Surface_Class_t *instance = (const Surface_Class_t *)lua_touserdata(L, 1);
+    int x = lua_tointeger(L, 2);
+    int y = lua_tointeger(L, 3);
+    lua_Integer width = lua_tointeger(L, 4);
+    lua_Integer height = lua_tointeger(L, 5);
+
+    if (width < 0 || height < 0) {
+        return luaL_error(L, "invalid %dx%d area", (int)width, (int)height);
+    }
+
+    const Display_t *display = (const Display_t *)lua_touserdata(L, lua_upvalueindex(USERDATA_DISPLAY));
+
+    const GL_Context_t *context = &display->gl;
+    GL_context_flush(context); // The surface could be the target of pending commands.
+
+    const size_t size = (size_t)width * (size_t)height * sizeof(GL_Pixel_t);
+    luaL_Buffer buffer;
+    GL_Pixel_t *pixels = (GL_Pixel_t *)luaL_buffinitsize(L, &buffer, size);
+    GL_surface_read(&instance->surface, (GL_Rectangle_t){ .x = x, .y = y, .width = (size_t)width, .height = (size_t)height }, pixels);
+    luaL_pushresultsize(&buffer, size);
+
+    return 1;
+}
+
+static int surface_write(lua_State *L)
+{
+    LUAX_SIGNATURE_BEGIN(L, 6)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TUSERDATA)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TSTRING)
+    LUAX_SIGNATURE_END
+    Surface_Class_t *instance = (Surface_Class_t *)lua_touserdata(L, 1);
+    int x = lua_tointeger(L, 2);
+    int y = lua_tointeger(L, 3);
+    lua_Integer width = lua_tointeger(L, 4);
+    lua_Integer height = lua_tointeger(L, 5);
+    size_t length;
+    const char *bytes = lua_tolstring(L, 6, &length);
+
+    if (width < 0 || height < 0) {
+        return luaL_error(L, "invalid %dx%d area", (int)width, (int)height);
+    }
+
+    if (length < (size_t)width * (size_t)height * sizeof(GL_Pixel_t)) {
+        return luaL_error(L, "%d bytes are too few for a %dx%d area", (int)length, (int)width, (int)height);
+    }
+
+    const Display_t *display = (const Display_t *)lua_touserdata(L, lua_upvalueindex(USERDATA_DISPLAY));
+
+    const GL_Context_t *context = &display->gl;
+    GL_context_flush(context); // Pending commands could be reading from the surface.
+
+    GL_surface_write(&instance->surface, (GL_Rectangle_t){ .x = x, .y = y, .width = (size_t)width, .height = (size_t)height }, (const GL_Pixel_t *)bytes);
+
+    return 0;
+}
+
 static int surface_blit1(lua_State *L)
 {
     LUAX_SIGNATURE_BEGIN(L, 1)
@@ -516,6 +656,58 @@ static int surface_xform(lua_State *L)
     LUAX_OVERLOAD_END
 }
 
+static int surface_quad(lua_State *L)
+{
+    LUAX_SIGNATURE_BEGIN(L, 17)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TUSERDATA)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+    LUAX_SIGNATURE_END
+    Surface_Class_t *instance = (Surface_Class_t *)lua_touserdata(L, 1);
+    int x0 = lua_tointeger(L, 2);
+    int y0 = lua_tointeger(L, 3);
+    float u0 = lua_tonumber(L, 4);
+    float v0 = lua_tonumber(L, 5);
+    int x1 = lua_tointeger(L, 6);
+    int y1 = lua_tointeger(L, 7);
+    float u1 = lua_tonumber(L, 8);
+    float v1 = lua_tonumber(L, 9);
+    int x2 = lua_tointeger(L, 10);
+    int y2 = lua_tointeger(L, 11);
+    float u2 = lua_tonumber(L, 12);
+    float v2 = lua_tonumber(L, 13);
+    int x3 = lua_tointeger(L, 14);
+    int y3 = lua_tointeger(L, 15);
+    float u3 = lua_tonumber(L, 16);
+    float v3 = lua_tonumber(L, 17);
+
+    const Display_t *display = (const Display_t *)lua_touserdata(L, lua_upvalueindex(USERDATA_DISPLAY));
+
+    const GL_Context_t *context = &display->gl;
+    const GL_Surface_t *surface = &instance->surface;
+    GL_primitive_textured_quad(context, surface,
+        (GL_Vertex_t){ .x = x0, .y = y0, .u = u0, .v = v0 },
+        (GL_Vertex_t){ .x = x1, .y = y1, .u = u1, .v = v1 },
+        (GL_Vertex_t){ .x = x2, .y = y2, .u = u2, .v = v2 },
+        (GL_Vertex_t){ .x = x3, .y = y3, .u = u3, .v = v3 });
+
+    return 0;
+}
+
 static int surface_offset(lua_State *L)
 {
     LUAX_SIGNATURE_BEGIN(L, 3)
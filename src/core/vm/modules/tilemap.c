@@ -0,0 +1,513 @@
+/*
+ * Copyright (c) 2019-2020 by Marco Lizza (marco.lizza@gmail.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+#include "tilemap.h"
+
+#include <config.h>
+#include <core/io/display.h>
+#include <core/vm/interpreter.h>
+#include <libs/imath.h>
+#include <libs/log.h>
+#include <libs/gl/gl.h>
+
+#include "udt.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LOG_CONTEXT "tilemap"
+
+#define TILEMAP_MT      "Tofu_Tilemap_mt"
+
+#define TILEMAP_DEFAULT_BUDGET  (1024 * 1024)
+
+// Amount of chunks, around the visible ones, that are retained even when exceeding the memory budget, so that
+// moving back and forth across a chunk boundary doesn't continuously re-render them.
+#define TILEMAP_MARGIN  1
+
+static int tilemap_new(lua_State *L);
+static int tilemap_gc(lua_State *L);
+static int tilemap_invalidate(lua_State *L);
+static int tilemap_draw(lua_State *L);
+
+static const struct luaL_Reg _tilemap_functions[] = {
+    { "new", tilemap_new },
+    {"__gc", tilemap_gc },
+    { "invalidate", tilemap_invalidate },
+    { "draw", tilemap_draw },
+    { NULL, NULL }
+};
+
+static const luaX_Const _tilemap_constants[] = {
+    { NULL }
+};
+
+int tilemap_loader(lua_State *L)
+{
+    int nup = luaX_pushupvalues(L);
+    return luaX_newmodule(L, NULL, _tilemap_functions, _tilemap_constants, nup, TILEMAP_MT);
+}
+
+static int create(lua_State *L, size_t budget)
+{
+    const Bank_Class_t *bank = (const Bank_Class_t *)lua_touserdata(L, 1);
+    const Grid_Class_t *grid = (const Grid_Class_t *)lua_touserdata(L, 2);
+    size_t chunk_columns = (size_t)lua_tointeger(L, 3);
+    size_t chunk_rows = (size_t)lua_tointeger(L, 4);
+
+    if (chunk_columns == 0 || chunk_rows == 0) {
+        return luaL_error(L, "invalid chunk size %dx%d", (int)chunk_columns, (int)chunk_rows);
+    }
+
+    const size_t columns = (grid->width + chunk_columns - 1) / chunk_columns;
+    const size_t rows = (grid->height + chunk_rows - 1) / chunk_rows;
+
+    Tilemap_Chunk_t **chunks = calloc(columns * rows, sizeof(Tilemap_Chunk_t *));
+    if (!chunks) {
+        return luaL_error(L, "can't allocate memory");
+    }
+
+    Tilemap_Class_t *instance = (Tilemap_Class_t *)lua_newuserdata(L, sizeof(Tilemap_Class_t));
+    *instance = (Tilemap_Class_t){
+            .bank = bank,
+            .bank_reference = luaX_ref(L, 1), // Both the bank and the grid are referenced to prevent garbage collection.
+            .grid = grid,
+            .grid_reference = luaX_ref(L, 2),
+            .chunk_size = (GL_Size_t){ .width = chunk_columns, .height = chunk_rows },
+            .columns = columns,
+            .rows = rows,
+            .chunks = chunks,
+            .generation = grid->generation,
+            .frame = 0,
+            .budget = budget,
+            .memory = 0
+        };
+    Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "tilemap allocated as %p w/ %dx%d chunks", instance, (int)columns, (int)rows);
+
+    luaL_setmetatable(L, TILEMAP_MT);
+
+    return 1;
+}
+
+static int tilemap_new4(lua_State *L)
+{
+    LUAX_SIGNATURE_BEGIN(L, 4)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TUSERDATA)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TUSERDATA)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+    LUAX_SIGNATURE_END
+
+    return create(L, TILEMAP_DEFAULT_BUDGET);
+}
+
+static int tilemap_new5(lua_State *L)
+{
+    LUAX_SIGNATURE_BEGIN(L, 5)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TUSERDATA)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TUSERDATA)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+    LUAX_SIGNATURE_END
+    size_t budget = (size_t)lua_tointeger(L, 5);
+
+    return create(L, budget);
+}
+
+static int tilemap_new(lua_State *L)
+{
+    LUAX_OVERLOAD_BEGIN(L)
+        LUAX_OVERLOAD_ARITY(4, tilemap_new4)
+        LUAX_OVERLOAD_ARITY(5, tilemap_new5)
+    LUAX_OVERLOAD_END
+}
+
+static void evict(Tilemap_Class_t *tilemap, size_t index)
+{
+    Tilemap_Chunk_t *chunk = tilemap->chunks[index];
+    tilemap->memory -= chunk->surface.data_size;
+    GL_surface_delete(&chunk->surface);
+    free(chunk->cells);
+    free(chunk);
+    tilemap->chunks[index] = NULL;
+}
+
+static void evict_all(Tilemap_Class_t *tilemap)
+{
+    for (size_t i = 0; i < tilemap->columns * tilemap->rows; ++i) {
+        if (tilemap->chunks[i]) {
+            evict(tilemap, i);
+        }
+    }
+}
+
+static int tilemap_gc(lua_State *L)
+{
+    LUAX_SIGNATURE_BEGIN(L, 1)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TUSERDATA)
+    LUAX_SIGNATURE_END
+    Tilemap_Class_t *instance = (Tilemap_Class_t *)lua_touserdata(L, 1);
+
+    Display_t *display = (Display_t *)lua_touserdata(L, lua_upvalueindex(USERDATA_DISPLAY));
+
+    GL_context_flush(&display->gl); // Pending commands could be referring the chunks.
+
+    evict_all(instance);
+    free(instance->chunks);
+    Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "tilemap %p chunks deallocated", instance);
+
+    luaX_unref(L, instance->grid_reference);
+    luaX_unref(L, instance->bank_reference);
+
+    Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "tilemap %p finalized", instance);
+
+    return 0;
+}
+
+// Needed when the bank pixels change, since (unlike the grid cells) they aren't tracked.
+static int tilemap_invalidate(lua_State *L)
+{
+    LUAX_SIGNATURE_BEGIN(L, 1)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TUSERDATA)
+    LUAX_SIGNATURE_END
+    Tilemap_Class_t *instance = (Tilemap_Class_t *)lua_touserdata(L, 1);
+
+    Display_t *display = (Display_t *)lua_touserdata(L, lua_upvalueindex(USERDATA_DISPLAY));
+
+    GL_context_flush(&display->gl);
+
+    evict_all(instance);
+
+    return 0;
+}
+
+static inline int floor_div(int a, int b)
+{
+    return a >= 0 ? a / b : -((b - 1 - a) / b);
+}
+
+// The area of the grid covered by the chunk, clamped for the chunks on the right/bottom edges.
+static inline GL_Rectangle_t chunk_area(const Tilemap_Class_t *tilemap, size_t column, size_t row)
+{
+    const size_t x = column * tilemap->chunk_size.width;
+    const size_t y = row * tilemap->chunk_size.height;
+    return (GL_Rectangle_t){
+            .x = (int)x,
+            .y = (int)y,
+            .width = imin((int)tilemap->chunk_size.width, (int)(tilemap->grid->width - x)),
+            .height = imin((int)tilemap->chunk_size.height, (int)(tilemap->grid->height - y))
+        };
+}
+
+static bool is_stale(const Tilemap_Class_t *tilemap, const Tilemap_Chunk_t *chunk, GL_Rectangle_t area)
+{
+    const Grid_Class_t *grid = tilemap->grid;
+    const Cell_t *cells = chunk->cells;
+    const Cell_t *data = grid->data + area.y * grid->width + area.x;
+    for (size_t i = 0; i < area.height; ++i) {
+        if (memcmp(cells, data, sizeof(Cell_t) * area.width) != 0) {
+            return true;
+        }
+        cells += area.width;
+        data += grid->width;
+    }
+    return false;
+}
+
+// The cells pixels are copied as they are (i.e. the current shifting and transparency are applied when the
+// whole chunk is blitted, the same as when drawing the single cells). Empty cells (i.e. out of range ids) are
+// filled with index `0`, which is transparent by default.
+static void render(const Tilemap_Class_t *tilemap, Tilemap_Chunk_t *chunk, GL_Rectangle_t area)
+{
+    const Grid_Class_t *grid = tilemap->grid;
+    const GL_Sheet_t *sheet = &tilemap->bank->sheet;
+    const size_t cell_width = sheet->size.width;
+    const size_t cell_height = sheet->size.height;
+    const int count = (int)((sheet->atlas.width / cell_width) * (sheet->atlas.height / cell_height));
+
+    const GL_Surface_t *atlas = &sheet->atlas;
+    const GL_Surface_t *surface = &chunk->surface;
+
+    Cell_t *cells = chunk->cells;
+    const Cell_t *data = grid->data + area.y * grid->width + area.x;
+    for (size_t row = 0; row < area.height; ++row) {
+        for (size_t column = 0; column < area.width; ++column) {
+            const Cell_t value = data[column];
+            *(cells++) = value;
+
+            GL_Pixel_t *dst = surface->data + row * cell_height * surface->stride + column * cell_width;
+
+            const int cell_id = (int)value;
+            if (cell_id < 0 || cell_id >= count) {
+                for (size_t i = 0; i < cell_height; ++i) {
+                    memset(dst, 0, cell_width);
+                    dst += surface->stride;
+                }
+                continue;
+            }
+
+            const GL_Rectangle_t *cell = &sheet->cells[cell_id];
+            const GL_Pixel_t *src = atlas->data + cell->y * atlas->stride + cell->x;
+            for (size_t i = 0; i < cell_height; ++i) {
+                memcpy(dst, src, cell_width);
+                src += atlas->stride;
+                dst += surface->stride;
+            }
+        }
+        data += grid->width;
+    }
+}
+
+// When the grid has been changed, the resident chunks are compared against it and re-rendered if needed. This is
+// cheaper than tracking the changed cells, as the chunks are just a few and the grid rarely changes.
+static void refresh(Tilemap_Class_t *tilemap, const GL_Context_t *context)
+{
+    if (tilemap->generation == tilemap->grid->generation) {
+        return;
+    }
+    tilemap->generation = tilemap->grid->generation;
+
+    bool flushed = false;
+    for (size_t row = 0; row < tilemap->rows; ++row) {
+        for (size_t column = 0; column < tilemap->columns; ++column) {
+            Tilemap_Chunk_t *chunk = tilemap->chunks[row * tilemap->columns + column];
+            if (!chunk) {
+                continue;
+            }
+            const GL_Rectangle_t area = chunk_area(tilemap, column, row);
+            if (!is_stale(tilemap, chunk, area)) {
+                continue;
+            }
+            if (!flushed) {
+                GL_context_flush(context); // Pending commands could be referring the chunk.
+                flushed = true;
+            }
+            render(tilemap, chunk, area);
+        }
+    }
+}
+
+static Tilemap_Chunk_t *fetch(Tilemap_Class_t *tilemap, size_t column, size_t row)
+{
+    const size_t index = row * tilemap->columns + column;
+    const GL_Rectangle_t area = chunk_area(tilemap, column, row);
+
+    Tilemap_Chunk_t *chunk = tilemap->chunks[index];
+    if (!chunk) {
+        chunk = malloc(sizeof(Tilemap_Chunk_t));
+        if (!chunk) {
+            Log_write(LOG_LEVELS_ERROR, LOG_CONTEXT, "can't allocate chunk");
+            return NULL;
+        }
+        chunk->cells = malloc(sizeof(Cell_t) * area.width * area.height);
+        if (!chunk->cells) {
+            Log_write(LOG_LEVELS_ERROR, LOG_CONTEXT, "can't allocate chunk cells");
+            free(chunk);
+            return NULL;
+        }
+        if (!GL_surface_create(&chunk->surface, area.width * tilemap->bank->sheet.size.width, area.height * tilemap->bank->sheet.size.height)) {
+            Log_write(LOG_LEVELS_ERROR, LOG_CONTEXT, "can't allocate chunk surface");
+            free(chunk->cells);
+            free(chunk);
+            return NULL;
+        }
+        tilemap->chunks[index] = chunk;
+        tilemap->memory += chunk->surface.data_size;
+        render(tilemap, chunk, area);
+    }
+    chunk->frame = tilemap->frame;
+    return chunk;
+}
+
+typedef struct _Candidate_t {
+    size_t index;
+    size_t frame;
+} Candidate_t;
+
+static int candidate_compare(const void *lhs, const void *rhs)
+{
+    const Candidate_t *l = (const Candidate_t *)lhs;
+    const Candidate_t *r = (const Candidate_t *)rhs;
+    return l->frame < r->frame ? -1 : (l->frame > r->frame ? 1 : 0);
+}
+
+// When over budget, the chunks lying beyond the margin around the visible ones are evicted, least recently used
+// first. The visible (and margin) ones are always kept, so the budget can be exceeded by a large enough view.
+static void trim(Tilemap_Class_t *tilemap, const GL_Context_t *context, int column0, int row0, int column1, int row1)
+{
+    if (tilemap->memory <= tilemap->budget) {
+        return;
+    }
+
+    Candidate_t *candidates = malloc(sizeof(Candidate_t) * tilemap->columns * tilemap->rows);
+    if (!candidates) {
+        Log_write(LOG_LEVELS_ERROR, LOG_CONTEXT, "can't allocate eviction candidates");
+        return;
+    }
+
+    size_t count = 0;
+    for (int row = 0; row < (int)tilemap->rows; ++row) {
+        for (int column = 0; column < (int)tilemap->columns; ++column) {
+            const size_t index = row * tilemap->columns + column;
+            const Tilemap_Chunk_t *chunk = tilemap->chunks[index];
+            if (!chunk) {
+                continue;
+            }
+            if (column >= column0 - TILEMAP_MARGIN && column <= column1 + TILEMAP_MARGIN
+                && row >= row0 - TILEMAP_MARGIN && row <= row1 + TILEMAP_MARGIN) {
+                continue;
+            }
+            candidates[count++] = (Candidate_t){ .index = index, .frame = chunk->frame };
+        }
+    }
+
+    if (count > 0) {
+        GL_context_flush(context); // Ditto.
+
+        qsort(candidates, count, sizeof(Candidate_t), candidate_compare);
+
+        for (size_t i = 0; i < count && tilemap->memory > tilemap->budget; ++i) {
+            evict(tilemap, candidates[i].index);
+        }
+    }
+
+    free(candidates);
+}
+
+// Same as `Bank:tilemap()`, but composing the view with one blit per (visible) chunk.
+static void draw(Tilemap_Class_t *tilemap, const GL_Context_t *context, GL_Point_t camera, GL_Size_t size, GL_Point_t screen, float scale)
+{
+    const int chunk_width = (int)(tilemap->chunk_size.width * tilemap->bank->sheet.size.width);
+    const int chunk_height = (int)(tilemap->chunk_size.height * tilemap->bank->sheet.size.height);
+
+    const GL_Quad_t *clipping_region = &context->state.clipping_region;
+    const int x0 = imax(screen.x, clipping_region->x0);
+    const int y0 = imax(screen.y, clipping_region->y0);
+    const int x1 = imin(screen.x + (int)((float)(size.width * tilemap->bank->sheet.size.width) * scale + 0.5f), clipping_region->x1 + 1);
+    const int y1 = imin(screen.y + (int)((float)(size.height * tilemap->bank->sheet.size.height) * scale + 0.5f), clipping_region->y1 + 1);
+    if (x0 >= x1 || y0 >= y1) {
+        return;
+    }
+
+    const int column0 = imax(floor_div(camera.x + (int)floorf((float)(x0 - screen.x) / scale), chunk_width), 0);
+    const int row0 = imax(floor_div(camera.y + (int)floorf((float)(y0 - screen.y) / scale), chunk_height), 0);
+    const int column1 = imin(floor_div(camera.x + (int)ceilf((float)(x1 - screen.x) / scale) - 1, chunk_width), (int)tilemap->columns - 1);
+    const int row1 = imin(floor_div(camera.y + (int)ceilf((float)(y1 - screen.y) / scale) - 1, chunk_height), (int)tilemap->rows - 1);
+    if (column0 > column1 || row0 > row1) {
+        return;
+    }
+
+    refresh(tilemap, context);
+
+    tilemap->frame += 1;
+
+    const bool unscaled = scale == 1.0f;
+
+    for (int row = row0; row <= row1; ++row) {
+        const int y = screen.y + (int)floorf((float)(row * chunk_height - camera.y) * scale);
+        for (int column = column0; column <= column1; ++column) {
+            const Tilemap_Chunk_t *chunk = fetch(tilemap, (size_t)column, (size_t)row);
+            if (!chunk) {
+                continue;
+            }
+            const int x = screen.x + (int)floorf((float)(column * chunk_width - camera.x) * scale);
+            const GL_Rectangle_t area = (GL_Rectangle_t){ .x = 0, .y = 0, .width = chunk->surface.width, .height = chunk->surface.height };
+            if (unscaled) {
+                GL_context_blit(context, &chunk->surface, area, (GL_Point_t){ .x = x, .y = y });
+            } else {
+                GL_context_blit_s(context, &chunk->surface, area, (GL_Point_t){ .x = x, .y = y }, scale, scale);
+            }
+        }
+    }
+
+    trim(tilemap, context, column0, row0, column1, row1);
+}
+
+static int tilemap_draw7(lua_State *L)
+{
+    LUAX_SIGNATURE_BEGIN(L, 7)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TUSERDATA)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+    LUAX_SIGNATURE_END
+    Tilemap_Class_t *instance = (Tilemap_Class_t *)lua_touserdata(L, 1);
+    int camera_x = lua_tointeger(L, 2);
+    int camera_y = lua_tointeger(L, 3);
+    size_t columns = (size_t)lua_tointeger(L, 4);
+    size_t rows = (size_t)lua_tointeger(L, 5);
+    int screen_x = lua_tointeger(L, 6);
+    int screen_y = lua_tointeger(L, 7);
+
+    const Display_t *display = (const Display_t *)lua_touserdata(L, lua_upvalueindex(USERDATA_DISPLAY));
+
+    draw(instance, &display->gl, (GL_Point_t){ .x = camera_x, .y = camera_y }, (GL_Size_t){ .width = columns, .height = rows },
+        (GL_Point_t){ .x = screen_x, .y = screen_y }, 1.0f);
+
+    return 0;
+}
+
+static int tilemap_draw8(lua_State *L)
+{
+    LUAX_SIGNATURE_BEGIN(L, 8)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TUSERDATA)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+        LUAX_SIGNATURE_ARGUMENT(LUA_TNUMBER)
+    LUAX_SIGNATURE_END
+    Tilemap_Class_t *instance = (Tilemap_Class_t *)lua_touserdata(L, 1);
+    int camera_x = lua_tointeger(L, 2);
+    int camera_y = lua_tointeger(L, 3);
+    size_t columns = (size_t)lua_tointeger(L, 4);
+    size_t rows = (size_t)lua_tointeger(L, 5);
+    int screen_x = lua_tointeger(L, 6);
+    int screen_y = lua_tointeger(L, 7);
+    float scale = lua_tonumber(L, 8);
+
+    if (!(scale > 0.0f)) {
+        return luaL_error(L, "scale %f must be positive", (double)scale);
+    }
+
+    const Display_t *display = (const Display_t *)lua_touserdata(L, lua_upvalueindex(USERDATA_DISPLAY));
+
+    draw(instance, &display->gl, (GL_Point_t){ .x = camera_x, .y = camera_y }, (GL_Size_t){ .width = columns, .height = rows },
+        (GL_Point_t){ .x = screen_x, .y = screen_y }, scale);
+
+    return 0;
+}
+
+static int tilemap_draw(lua_State *L)
+{
+    LUAX_OVERLOAD_BEGIN(L)
+        LUAX_OVERLOAD_ARITY(7, tilemap_draw7)
+        LUAX_OVERLOAD_ARITY(8, tilemap_draw8)
+    LUAX_OVERLOAD_END
+}
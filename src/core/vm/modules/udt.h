@@ -39,6 +39,9 @@ typedef struct _Bank_Class_t {
     // char full_path[PATH_FILE_MAX];
     GL_Sheet_t sheet;
     bool owned;
+    GL_Mask_t *masks; // Per-cell collision masks (of the trimmed area), lazily built by `Bank.collides()`.
+    GL_Point_t *offsets; // Position of each mask relative to its cell top-left corner.
+    GL_Bool_t transparent[GL_MAX_PALETTE_COLORS]; // Transparent indexes the masks have been built with.
 } Bank_Class_t;
 
 typedef struct _Canvas_Class_t {
@@ -69,6 +72,7 @@ typedef struct _Grid_Class_t {
     size_t width, height;
     Cell_t *data;
     size_t data_size;
+    size_t generation; // Bumped on every change to the cells, tracked by `Tilemap` to detect stale chunks.
 } Grid_Class_t;
 
 typedef struct _Input_Class_t {
@@ -84,10 +88,47 @@ typedef struct _Surface_Class_t {
     // char full_path[PATH_FILE_MAX];
     GL_Surface_t surface;
     GL_XForm_t xform;
+    GL_Mask_t mask; // Lazily built by `Canvas.mask()`.
+    bool packed; // Loaded from file, living in the display atlas (see `GL_atlas_fetch()`).
 } Surface_Class_t;
 
+typedef struct _SpriteList_Class_t {
+    const void *bogus;
+    const Bank_Class_t *bank;
+    luaX_Reference bank_reference;
+    void *memory; // Backing block of all the arrays below.
+    size_t count, capacity;
+    // Per-sprite fields, stored as parallel arrays.
+    size_t *cells;
+    float *xs, *ys;
+    float *depths;
+    // Scratch buffers for `draw()`, sized as the capacity.
+    uint32_t *keys;
+    uint32_t *order, *swap;
+} SpriteList_Class_t;
+
 typedef struct _System_Class_t {
     const void *bogus;
 } System_Class_t;
 
+typedef struct _Tilemap_Chunk_t {
+    GL_Surface_t surface; // Pre-rendered cells, raw (i.e. not shifted) pixels.
+    Cell_t *cells; // Copy of the grid cells the surface was rendered from.
+    size_t frame; // Last `draw()` the chunk was used by.
+} Tilemap_Chunk_t;
+
+typedef struct _Tilemap_Class_t {
+    const void *bogus;
+    const Bank_Class_t *bank;
+    luaX_Reference bank_reference;
+    const Grid_Class_t *grid;
+    luaX_Reference grid_reference;
+    GL_Size_t chunk_size; // In cells.
+    size_t columns, rows; // In chunks.
+    Tilemap_Chunk_t **chunks; // `columns * rows` entries, `NULL` when not resident.
+    size_t generation; // Grid generation the chunks have been checked against.
+    size_t frame;
+    size_t budget, memory; // In bytes.
+} Tilemap_Class_t;
+
 #endif  /* __MODULES_UDT_H__ */
\ No newline at end of file
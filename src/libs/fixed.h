@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) 2019-2020 by Marco Lizza (marco.lizza@gmail.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+#ifndef __LIBS_FIXED_H__
+#define __LIBS_FIXED_H__
+
+#include <stdint.h>
+
+// Signed 16.16 fixed-point arithmetic, used to step texture coordinates in the inner loops.
+typedef int32_t fixed_t;
+
+#define FIXED_SHIFT     16
+#define FIXED_ONE       ((fixed_t)1 << FIXED_SHIFT)
+
+#define FIXED_FROM_INT(i)       ((fixed_t)(i) * FIXED_ONE)
+#define FIXED_FROM_FLOAT(f)     ((fixed_t)((f) * (float)FIXED_ONE))
+#define FIXED_TO_INT(x)         ((int)((x) >> FIXED_SHIFT)) // Rounds toward minus infinity, like `floorf()`.
+
+// Signed 32.32 fixed-point, for longer interpolations where the 16.16 step error would add up too much (e.g. rotations).
+typedef int64_t fixed64_t;
+
+#define FIXED64_SHIFT           32
+#define FIXED64_ONE             ((fixed64_t)1 << FIXED64_SHIFT)
+
+#define FIXED64_FROM_INT(i)     ((fixed64_t)(i) * FIXED64_ONE)
+#define FIXED64_FROM_FLOAT(f)   ((fixed64_t)((double)(f) * (double)FIXED64_ONE))
+#define FIXED64_TO_INT(x)       ((int)((x) >> FIXED64_SHIFT))
+
+#endif  /* __LIBS_FIXED_H__ */
@@ -0,0 +1,224 @@
+/*
+ * Copyright (c) 2019-2020 by Marco Lizza (marco.lizza@gmail.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+#include "atlas.h"
+
+#include <config.h>
+#include <libs/log.h>
+#include <libs/stb.h>
+
+#include <limits.h>
+#include <string.h>
+
+#define LOG_CONTEXT "gl-atlas"
+
+static void page_reset(GL_Atlas_Page_t *page)
+{
+    memset(page->surface.data, 0, page->surface.data_size); // Padding is made of (transparent) index zero pixels.
+    arrsetlen(page->skyline, 1);
+    page->skyline[0] = (GL_Atlas_Node_t){ .x = 0, .y = 0, .width = (int)page->surface.width };
+    page->used = 0;
+    page->references = 0;
+}
+
+// Returns the lowest row a `width` wide rectangle can be placed at, when left-aligned to the `index`-th node, or `-1`
+// when it doesn't fit.
+static int page_fit(const GL_Atlas_Page_t *page, size_t index, int width, int height)
+{
+    const GL_Atlas_Node_t *skyline = page->skyline;
+    const int x = skyline[index].x;
+    if (x + width > (int)page->surface.width) {
+        return -1;
+    }
+    int y = skyline[index].y;
+    for (int remaining = width; remaining > 0; remaining -= skyline[index++].width) { // The skyline spans the page.
+        if (y < skyline[index].y) {
+            y = skyline[index].y;
+        }
+        if (y + height > (int)page->surface.height) {
+            return -1;
+        }
+    }
+    return y;
+}
+
+// Bottom-left heuristic: pick the position that keeps the rectangle top-edge the lowest, preferring the narrowest
+// segments to limit the waste. Then raise the skyline over the rectangle, shrinking (or removing) the covered nodes
+// and merging the ones at the same height.
+static bool page_insert(GL_Atlas_Page_t *page, int width, int height, GL_Point_t *position)
+{
+    int best_top = INT_MAX, best_width = INT_MAX;
+    size_t best_index = 0;
+    for (size_t i = 0; i < (size_t)arrlen(page->skyline); ++i) {
+        const int y = page_fit(page, i, width, height);
+        if (y < 0) {
+            continue;
+        }
+        const int top = y + height;
+        if (top < best_top || (top == best_top && page->skyline[i].width < best_width)) {
+            best_top = top;
+            best_width = page->skyline[i].width;
+            best_index = i;
+        }
+    }
+    if (best_top == INT_MAX) {
+        return false;
+    }
+
+    const GL_Atlas_Node_t node = (GL_Atlas_Node_t){ .x = page->skyline[best_index].x, .y = best_top, .width = width };
+    *position = (GL_Point_t){ .x = node.x, .y = best_top - height };
+
+    arrins(page->skyline, best_index, node);
+    for (size_t i = best_index + 1; i < (size_t)arrlen(page->skyline); ) {
+        GL_Atlas_Node_t *current = &page->skyline[i];
+        const int overlap = node.x + node.width - current->x;
+        if (overlap <= 0) {
+            break;
+        }
+        if (overlap < current->width) {
+            current->x += overlap;
+            current->width -= overlap;
+            break;
+        }
+        arrdel(page->skyline, i);
+    }
+    for (size_t i = 1; i < (size_t)arrlen(page->skyline); ) {
+        if (page->skyline[i - 1].y == page->skyline[i].y) {
+            page->skyline[i - 1].width += page->skyline[i].width;
+            arrdel(page->skyline, i);
+        } else {
+            ++i;
+        }
+    }
+    return true;
+}
+
+static GL_Atlas_Page_t *page_add(GL_Atlas_t *atlas)
+{
+    GL_Atlas_Page_t page = { 0 };
+    if (!GL_surface_create(&page.surface, atlas->size.width, atlas->size.height)) {
+        Log_write(LOG_LEVELS_ERROR, LOG_CONTEXT, "can't allocate %dx%d page", atlas->size.width, atlas->size.height);
+        return NULL;
+    }
+    page_reset(&page);
+    arrpush(atlas->pages, page);
+    Log_write(LOG_LEVELS_INFO, LOG_CONTEXT, "page #%d added to atlas %p (occupancy %.1f%%)", arrlen(atlas->pages), atlas, GL_atlas_occupancy(atlas) * 100.0f);
+    return &arrlast(atlas->pages);
+}
+
+bool GL_atlas_create(GL_Atlas_t *atlas, size_t width, size_t height, size_t padding)
+{
+    *atlas = (GL_Atlas_t){
+            .pages = NULL,
+            .size = (GL_Size_t){ .width = width, .height = height },
+            .padding = padding
+        };
+    Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "atlas %p created w/ %dx%d pages (padding %d)", atlas, width, height, padding);
+    return true;
+}
+
+void GL_atlas_delete(GL_Atlas_t *atlas)
+{
+    for (size_t i = 0; i < (size_t)arrlen(atlas->pages); ++i) {
+        GL_Atlas_Page_t *page = &atlas->pages[i];
+        if (page->references > 0) {
+            Log_write(LOG_LEVELS_WARNING, LOG_CONTEXT, "page #%d of atlas %p still has %d image(s)", i, atlas, page->references);
+        }
+        arrfree(page->skyline);
+        GL_surface_delete(&page->surface);
+    }
+    arrfree(atlas->pages);
+    Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "atlas %p deleted", atlas);
+}
+
+// The image is placed on the first page with enough room, a new page being added when none has it. The resulting
+// surface is a view, and must be handed back with `GL_atlas_release()`.
+bool GL_atlas_fetch(GL_Atlas_t *atlas, GL_Surface_t *surface, GL_Image_t image, const GL_Surface_Callback_t callback, void *user_data)
+{
+    const int padding = (int)atlas->padding;
+    const int width = (int)image.width + padding; // The leading padding only, the page borders need none.
+    const int height = (int)image.height + padding;
+    if (width > (int)atlas->size.width || height > (int)atlas->size.height) {
+        Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "%dx%d image doesn't fit atlas %p, not packing", image.width, image.height, atlas);
+        return GL_surface_fetch(surface, image, callback, user_data);
+    }
+
+    GL_Atlas_Page_t *page = NULL;
+    GL_Point_t position;
+    for (size_t i = 0; i < (size_t)arrlen(atlas->pages) && !page; ++i) {
+        if (page_insert(&atlas->pages[i], width, height, &position)) {
+            page = &atlas->pages[i];
+        }
+    }
+    if (!page) {
+        page = page_add(atlas);
+        if (!page || !page_insert(page, width, height, &position)) {
+            return false;
+        }
+    }
+
+    GL_surface_view(surface, &page->surface, (GL_Rectangle_t){ .x = position.x + padding, .y = position.y + padding, .width = image.width, .height = image.height });
+    page->used += image.width * image.height;
+    page->references += 1;
+
+    if (callback != NULL) {
+        callback(user_data, surface, image.data);
+    }
+
+    Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "image packed at <%d, %d> in page %p (%dx%d)", position.x + padding, position.y + padding, page->surface.data, image.width, image.height);
+
+    return true;
+}
+
+void GL_atlas_release(GL_Atlas_t *atlas, GL_Surface_t *surface)
+{
+    if (surface->memory) { // Not packed, it's owned.
+        GL_surface_delete(surface);
+        return;
+    }
+    for (size_t i = 0; i < (size_t)arrlen(atlas->pages); ++i) {
+        GL_Atlas_Page_t *page = &atlas->pages[i];
+        if (!GL_surface_aliases(&page->surface, surface)) {
+            continue;
+        }
+        page->references -= 1;
+        if (page->references == 0) {
+            page_reset(page);
+            Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "page #%d of atlas %p emptied", i, atlas);
+        }
+        break;
+    }
+    GL_surface_delete(surface);
+}
+
+float GL_atlas_occupancy(const GL_Atlas_t *atlas)
+{
+    const size_t count = arrlen(atlas->pages);
+    if (count == 0) {
+        return 0.0f;
+    }
+    size_t used = 0;
+    for (size_t i = 0; i < count; ++i) {
+        used += atlas->pages[i].used;
+    }
+    return (float)used / (float)(count * atlas->size.width * atlas->size.height);
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2019-2020 by Marco Lizza (marco.lizza@gmail.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+#ifndef __GL_ATLAS_H__
+#define __GL_ATLAS_H__
+
+#include <stdbool.h>
+
+#include "common.h"
+#include "surface.h"
+
+typedef struct _GL_Atlas_Node_t {
+    int x, y, width; // A segment of the skyline, i.e. the lowest free row above the `[x, x + width)` columns.
+} GL_Atlas_Node_t;
+
+typedef struct _GL_Atlas_Page_t {
+    GL_Surface_t surface;
+    GL_Atlas_Node_t *skyline;
+    size_t used; // Pixels packed so far, padding excluded.
+    size_t references; // Live views, the page is reset when they are all released.
+} GL_Atlas_Page_t;
+
+// Images are packed into shared (and fixed-size) pages, with a skyline bottom-left packer, and handed out as views.
+// Each image is surrounded by a `padding` wide border of index zero pixels. Images bigger than a page (or all of them,
+// when the page size is zero) get a surface of their own, instead.
+//
+// Space isn't reclaimed when a single image is released, but only once all the images of a page are gone.
+typedef struct _GL_Atlas_t {
+    GL_Atlas_Page_t *pages;
+    GL_Size_t size;
+    size_t padding;
+} GL_Atlas_t;
+
+extern bool GL_atlas_create(GL_Atlas_t *atlas, size_t width, size_t height, size_t padding);
+extern void GL_atlas_delete(GL_Atlas_t *atlas);
+extern bool GL_atlas_fetch(GL_Atlas_t *atlas, GL_Surface_t *surface, GL_Image_t image, const GL_Surface_Callback_t callback, void *user_data);
+extern void GL_atlas_release(GL_Atlas_t *atlas, GL_Surface_t *surface);
+extern float GL_atlas_occupancy(const GL_Atlas_t *atlas);
+
+#endif  /* __GL_ATLAS_H__ */
@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2019-2020 by Marco Lizza (marco.lizza@gmail.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+#include "blend.h"
+
+#include <config.h>
+#include <libs/imath.h>
+#include <libs/log.h>
+#include <libs/stb.h>
+
+#include <stdlib.h>
+
+#define LOG_CONTEXT "gl-blend"
+
+static inline int combine(GL_Blend_Modes_t mode, int source, int destination, int level)
+{
+    int value;
+    switch (mode) {
+        case GL_BLEND_MODE_ADD: {
+            return imin(destination + source * level / GL_BLEND_STEPS, 255);
+        }
+        case GL_BLEND_MODE_SUBTRACT: {
+            return imax(destination - source * level / GL_BLEND_STEPS, 0);
+        }
+        case GL_BLEND_MODE_MULTIPLY: {
+            value = source * destination / 255;
+            break;
+        }
+        case GL_BLEND_MODE_SCREEN: {
+            value = 255 - (255 - source) * (255 - destination) / 255;
+            break;
+        }
+        case GL_BLEND_MODE_ALPHA:
+        default: {
+            value = source;
+            break;
+        }
+    }
+    return destination + (value - destination) * level / GL_BLEND_STEPS; // Fade the effect by the opacity.
+}
+
+// Only the palette colors are combined, the other (unused) entries simply overwrite the destination.
+void GL_blend_table(GL_Pixel_t *table, const GL_Palette_t *palette, GL_Blend_Modes_t mode, int level)
+{
+    for (size_t i = 0; i < GL_MAX_PALETTE_COLORS; ++i) {
+        GL_Pixel_t *row = table + i * GL_MAX_PALETTE_COLORS;
+        for (size_t j = 0; j < GL_MAX_PALETTE_COLORS; ++j) {
+            if (i >= palette->count || j >= palette->count) {
+                row[j] = (GL_Pixel_t)i;
+                continue;
+            }
+            const GL_Color_t *source = &palette->colors[i];
+            const GL_Color_t *destination = &palette->colors[j];
+            const GL_Color_t color = (GL_Color_t){
+                    .r = (uint8_t)combine(mode, source->r, destination->r, level),
+                    .g = (uint8_t)combine(mode, source->g, destination->g, level),
+                    .b = (uint8_t)combine(mode, source->b, destination->b, level),
+                    .a = 255
+                };
+            row[j] = GL_palette_find_nearest_color(palette, color);
+        }
+    }
+}
+
+bool GL_blends_create(GL_Blends_t *blends)
+{
+    *blends = (GL_Blends_t){ 0 };
+
+    Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "blends created");
+    return true;
+}
+
+void GL_blends_delete(GL_Blends_t *blends)
+{
+    for (ptrdiff_t i = 0; i < arrlen(blends->tables); ++i) {
+        free(blends->tables[i].data);
+    }
+    arrfree(blends->tables);
+
+    Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "blends deleted");
+}
+
+const GL_Pixel_t *GL_blends_fetch(GL_Blends_t *blends, const GL_Palette_t *palette, GL_Blend_Modes_t mode, float alpha)
+{
+    const int level = imax(0, imin((int)(alpha * (float)GL_BLEND_STEPS + 0.5f), GL_BLEND_STEPS));
+
+    for (ptrdiff_t i = 0; i < arrlen(blends->tables); ++i) {
+        const GL_Blend_Table_t *table = &blends->tables[i];
+        if (table->mode == mode && table->level == level) {
+            return table->data;
+        }
+    }
+
+    GL_Pixel_t *data = malloc(GL_MAX_PALETTE_COLORS * GL_MAX_PALETTE_COLORS * sizeof(GL_Pixel_t));
+    if (!data) {
+        Log_write(LOG_LEVELS_ERROR, LOG_CONTEXT, "can't allocate blending table");
+        return NULL;
+    }
+    GL_blend_table(data, palette, mode, level);
+
+    const GL_Blend_Table_t table = (GL_Blend_Table_t){ .mode = mode, .level = level, .data = data };
+    arrpush(blends->tables, table);
+    Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "blending table #%d built for mode %d at level %d", (int)arrlen(blends->tables) - 1, mode, level);
+
+    return data;
+}
+
+void GL_blends_update(GL_Blends_t *blends, const GL_Palette_t *palette)
+{
+    for (ptrdiff_t i = 0; i < arrlen(blends->tables); ++i) {
+        const GL_Blend_Table_t *table = &blends->tables[i];
+        GL_blend_table(table->data, palette, table->mode, table->level);
+    }
+    Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "%d blending table(s) rebuilt", (int)arrlen(blends->tables));
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2019-2020 by Marco Lizza (marco.lizza@gmail.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+#ifndef __GL_BLEND_H__
+#define __GL_BLEND_H__
+
+#include <stdbool.h>
+
+#include "common.h"
+#include "palette.h"
+
+#define GL_BLEND_STEPS      32 // The opacity is quantized to 1/32th of unit, to bound the amount of tables.
+
+typedef enum _GL_Blend_Modes_t {
+    GL_BLEND_MODE_ALPHA, // Translucency, i.e. `src * alpha + dst * (1 - alpha)`.
+    GL_BLEND_MODE_ADD,
+    GL_BLEND_MODE_SUBTRACT,
+    GL_BLEND_MODE_MULTIPLY,
+    GL_BLEND_MODE_SCREEN,
+    GL_Blend_Modes_t_CountOf
+} GL_Blend_Modes_t;
+
+typedef struct _GL_Blend_Table_t {
+    GL_Blend_Modes_t mode;
+    int level; // Opacity, in the `[0, GL_BLEND_STEPS]` range.
+    GL_Pixel_t *data; // `GL_MAX_PALETTE_COLORS` squared entries, indexed as `[source][destination]`.
+} GL_Blend_Table_t;
+
+// Blending tables built so far, for the current palette. When the palette changes they are rebuilt in place so that
+// the references held by the contexts (and their stacks) remain valid.
+typedef struct _GL_Blends_t {
+    GL_Blend_Table_t *tables;
+} GL_Blends_t;
+
+extern void GL_blend_table(GL_Pixel_t *table, const GL_Palette_t *palette, GL_Blend_Modes_t mode, int level);
+
+extern bool GL_blends_create(GL_Blends_t *blends);
+extern void GL_blends_delete(GL_Blends_t *blends);
+extern const GL_Pixel_t *GL_blends_fetch(GL_Blends_t *blends, const GL_Palette_t *palette, GL_Blend_Modes_t mode, float alpha);
+extern void GL_blends_update(GL_Blends_t *blends, const GL_Palette_t *palette);
+
+#endif  /* __GL_BLEND_H__ */
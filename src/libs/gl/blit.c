@@ -23,33 +23,250 @@
 #include "blit.h"
 
 #include <config.h>
+#include <libs/fixed.h>
 #include <libs/imath.h>
 #include <libs/log.h>
 #include <libs/sincos.h>
 
+#include "queue.h"
+#include "simd.h"
+
 #include <memory.h>
 #include <math.h>
 
+#define GL_BLIT_LINE_LENGTH     1024 // Scratch line used by the integer-scaling kernel, wider blits use a slower path.
+
 #ifdef __DEBUG_GRAPHICS__
 static inline void pixel(const GL_Context_t *context, int x, int y, int index)
 {
     GL_Surface_t *surface = context->state->surface;
-    surface->data[y * surface->width + x]= 240 + (index % 16);
+    surface->data[y * surface->stride + x]= 240 + (index % 16);
 }
 #endif
 
+// Kernels are generated in a few variants, according to the state fingerprint: the generic one (any shifting and
+// transparency), the *keyed* one (identity shifting and a single transparent index), and the *opaque* one (identity
+// shifting and no transparent index at all). When a blending table is active the *blended* one is used, which combines
+// the (shifted) source index with the destination one, and the *shaded* one when a colormap is active (which also
+// takes care of blending, if any). The macros below plot a pixel for each variant.
+typedef enum _Variants_t {
+    VARIANT_GENERIC,
+    VARIANT_KEYED,
+    VARIANT_OPAQUE,
+    VARIANT_BLENDED,
+    VARIANT_SHADED,
+    Variants_t_CountOf
+} Variants_t;
+
+typedef struct _Pixel_State_t {
+    const GL_Pixel_t *shifting;
+    const GL_Bool_t *transparent;
+    GL_Pixel_t key;
+    const GL_Pixel_t *blending;
+    // Shading, with the light level (rounding bias included) in 16.16 fixed-point. The current scanline is tracked
+    // by `shade_row()`, and the table is picked once per scanline unless there's an horizontal gradient.
+    const GL_Pixel_t *shades;
+    int max_level;
+    fixed_t level, dx, dy;
+    const GL_Pixel_t *ddata;
+    int dstride;
+    const GL_Pixel_t *row;
+    fixed_t row_level;
+    const GL_Pixel_t *shade;
+} Pixel_State_t;
+
+static inline const GL_Pixel_t *shade_table(const Pixel_State_t *pixel_state, fixed_t level)
+{
+    const int value = FIXED_TO_INT(level);
+    const int clamped = value < 0 ? 0 : (value > pixel_state->max_level ? pixel_state->max_level : value);
+    return pixel_state->shades + clamped * GL_MAX_PALETTE_COLORS;
+}
+
+static inline const GL_Pixel_t *shade(const Pixel_State_t *pixel_state, const GL_Pixel_t *dptr)
+{
+    if (pixel_state->dx == 0) {
+        return pixel_state->shade;
+    }
+    return shade_table(pixel_state, pixel_state->row_level + pixel_state->dx * (fixed_t)(dptr - pixel_state->row));
+}
+
+// To be called at the beginning of each scanline, with any pointer into it.
+static inline void shade_row(Pixel_State_t *pixel_state, const GL_Pixel_t *dptr)
+{
+    if (!pixel_state->shades) {
+        return;
+    }
+    const int y = (int)(dptr - pixel_state->ddata) / pixel_state->dstride;
+    pixel_state->row = pixel_state->ddata + y * pixel_state->dstride;
+    pixel_state->row_level = pixel_state->level + pixel_state->dy * y;
+    pixel_state->shade = shade_table(pixel_state, pixel_state->row_level);
+}
+
+#define PIXEL_generic(ps, dptr, value) \
+    do { \
+        const GL_Pixel_t index = (ps)->shifting[(value)]; \
+        if (!(ps)->transparent[index]) { \
+            *(dptr) = index; \
+        } \
+    } while (0)
+
+#define PIXEL_keyed(ps, dptr, value) \
+    do { \
+        const GL_Pixel_t index = (value); \
+        if (index != (ps)->key) { \
+            *(dptr) = index; \
+        } \
+    } while (0)
+
+#define PIXEL_opaque(ps, dptr, value) \
+    do { \
+        *(dptr) = (value); \
+    } while (0)
+
+#define PIXEL_blended(ps, dptr, value) \
+    do { \
+        const GL_Pixel_t index = (ps)->shifting[(value)]; \
+        if (!(ps)->transparent[index]) { \
+            *(dptr) = (ps)->blending[index * GL_MAX_PALETTE_COLORS + *(dptr)]; \
+        } \
+    } while (0)
+
+#define PIXEL_shaded(ps, dptr, value) \
+    do { \
+        const GL_Pixel_t index = (ps)->shifting[(value)]; \
+        if (!(ps)->transparent[index]) { \
+            const GL_Pixel_t shaded = shade((ps), (dptr))[index]; \
+            *(dptr) = (ps)->blending ? (ps)->blending[shaded * GL_MAX_PALETTE_COLORS + *(dptr)] : shaded; \
+        } \
+    } while (0)
+
+static inline Variants_t select_variant(const GL_State_t *state, Pixel_State_t *pixel_state)
+{
+    const GL_Fingerprint_t *fingerprint = &state->fingerprint;
+    *pixel_state = (Pixel_State_t){
+            .shifting = state->shifting,
+            .transparent = state->transparent,
+            .key = fingerprint->keys[0],
+            .blending = state->blending
+        };
+    if (fingerprint->shaded) {
+        const GL_Shading_t *shading = &state->shading;
+        pixel_state->shades = shading->colormap->data;
+        pixel_state->max_level = (int)shading->colormap->levels - 1;
+        pixel_state->level = FIXED_FROM_FLOAT(shading->level + 0.5f);
+        pixel_state->dx = FIXED_FROM_FLOAT(shading->dx);
+        pixel_state->dy = FIXED_FROM_FLOAT(shading->dy);
+        pixel_state->ddata = state->surface->data;
+        pixel_state->dstride = (int)state->surface->stride;
+        return VARIANT_SHADED;
+    }
+    if (fingerprint->blended) {
+        return VARIANT_BLENDED;
+    }
+    if (!fingerprint->identity || fingerprint->transparent > 1) {
+        return VARIANT_GENERIC;
+    }
+    return fingerprint->transparent == 1 ? VARIANT_KEYED : VARIANT_OPAQUE;
+}
+
+// Walks the runs of set mask bits along a scanline span, testing a whole word (i.e. 64 pixels) at a time. Pixels
+// outside the mask are never drawn.
+typedef struct _Mask_Runs_t {
+    const GL_Mask_Word_t *row;
+    int x; // Span origin, in mask columns.
+    int position, end; // Mask columns range still to be scanned.
+} Mask_Runs_t;
+
+static inline void mask_runs(Mask_Runs_t *runs, const GL_State_t *state, int x, int y, int width)
+{
+    const GL_Mask_t *mask = state->mask;
+    const int mx = x - state->mask_position.x;
+    const int my = y - state->mask_position.y;
+
+    *runs = (Mask_Runs_t){ .row = NULL, .x = mx, .position = mx < 0 ? 0 : mx, .end = mx + width };
+    if (runs->end > (int)mask->width) {
+        runs->end = (int)mask->width;
+    }
+    if (my >= 0 && my < (int)mask->height) {
+        runs->row = mask->data + (size_t)my * mask->stride;
+    }
+}
+
+// Find the first position, starting from `position`, whose bit is `value`.
+static inline int mask_find(const GL_Mask_Word_t *row, int position, int end, GL_Mask_Word_t value)
+{
+    while (position < end) {
+        const GL_Mask_Word_t word = (row[position / GL_MASK_WORD_BITS] ^ ~value) >> (position % GL_MASK_WORD_BITS);
+        if (word) {
+            position += __builtin_ctzll(word);
+            return position < end ? position : end;
+        }
+        position = (position | (GL_MASK_WORD_BITS - 1)) + 1; // Skip to the next word.
+    }
+    return end;
+}
+
+// Yields the next run as a (span relative) offset and count.
+static inline bool mask_next_run(Mask_Runs_t *runs, int *offset, int *count)
+{
+    if (!runs->row) {
+        return false;
+    }
+    const int from = mask_find(runs->row, runs->position, runs->end, ~(GL_Mask_Word_t)0);
+    if (from >= runs->end) {
+        return false;
+    }
+    const int to = mask_find(runs->row, from, runs->end, 0);
+    runs->position = to;
+    *offset = from - runs->x;
+    *count = to - from;
+    return true;
+}
+
+typedef void (*Blit_Scanline_t)(const Pixel_State_t *pixel_state, GL_Pixel_t *dptr, const GL_Pixel_t *sptr, int width);
+
+#define DEFINE_BLIT_SCANLINE(variant) \
+    static void blit_scanline_##variant(const Pixel_State_t *pixel_state, GL_Pixel_t *dptr, const GL_Pixel_t *sptr, int width) \
+    { \
+        for (int j = width; j; --j) { \
+            PIXEL_##variant(pixel_state, dptr, *sptr); \
+            ++dptr; \
+            ++sptr; \
+        } \
+    }
+
+DEFINE_BLIT_SCANLINE(generic)
+DEFINE_BLIT_SCANLINE(keyed)
+DEFINE_BLIT_SCANLINE(opaque)
+DEFINE_BLIT_SCANLINE(blended)
+DEFINE_BLIT_SCANLINE(shaded)
+
+static const Blit_Scanline_t _blit_scanlines[Variants_t_CountOf] = {
+    blit_scanline_generic,
+    blit_scanline_keyed,
+    blit_scanline_opaque,
+    blit_scanline_blended,
+    blit_scanline_shaded
+};
+
+// Few transparent indexes and no per-pixel lookups, the (shifted) source can be copied with SIMD instructions.
+static inline bool is_vectorizable(const GL_Fingerprint_t *fingerprint)
+{
+    return fingerprint->identity && fingerprint->transparent <= GL_SIMD_MAX_KEYS && !fingerprint->blended && !fingerprint->shaded;
+}
+
 // TODO: specifies `const` always? Is pedantic or useful?
 // TODO: define a `BlitInfo` and `BlitFunc` types to generalize?
 // https://dev.to/fenbf/please-declare-your-variables-as-const
 void GL_context_blit(const GL_Context_t *context, const GL_Surface_t *surface, GL_Rectangle_t area, GL_Point_t position)
 {
+    if (context->queue) {
+        GL_queue_blit(context->queue, &context->state, surface, area, position);
+        return;
+    }
+
     const GL_State_t *state = &context->state;
     const GL_Quad_t *clipping_region = &state->clipping_region;
-    const GL_Pixel_t *shifting = state->shifting;
-    const GL_Bool_t *transparent = state->transparent;
-#ifdef __GL_MASK_SUPPORT__
-    const GL_Mask_t *mask = &state->mask;
-#endif
 
     GL_Quad_t drawing_region = (GL_Quad_t){
             .x0 = position.x,
@@ -82,63 +299,340 @@ void GL_context_blit(const GL_Context_t *context, const GL_Surface_t *surface, G
         return;
     }
 
+    GL_surface_touch(state->surface, drawing_region.y0, drawing_region.y1);
+
     const GL_Pixel_t *sdata = surface->data;
     GL_Pixel_t *ddata = state->surface->data;
 
-    const int swidth = surface->width;
-    const int dwidth = state->surface->width;
+    const int sstride = surface->stride;
+    const int dstride = state->surface->stride;
+
+    const GL_Pixel_t *sptr = sdata + (area.y + skip_y) * sstride + (area.x + skip_x);
+    GL_Pixel_t *dptr = ddata + drawing_region.y0 * dstride + drawing_region.x0;
+
+    const GL_Fingerprint_t *fingerprint = &state->fingerprint;
+    const bool vectorized = is_vectorizable(fingerprint);
+
+    Pixel_State_t pixel_state;
+    const Blit_Scanline_t scanline = _blit_scanlines[select_variant(state, &pixel_state)];
 
-    const GL_Pixel_t *sptr = sdata + (area.y + skip_y) * swidth + (area.x + skip_x);
-    GL_Pixel_t *dptr = ddata + drawing_region.y0 * dwidth + drawing_region.x0;
+    for (int i = 0; i < height; ++i) {
+        shade_row(&pixel_state, dptr);
+
+        if (fingerprint->masked) {
+            Mask_Runs_t runs;
+            mask_runs(&runs, state, drawing_region.x0, drawing_region.y0 + i, width);
+            for (int offset, count; mask_next_run(&runs, &offset, &count); ) {
+                if (vectorized) {
+                    GL_simd_copy(dptr + offset, sptr + offset, count, fingerprint->keys, fingerprint->transparent);
+                } else {
+                    scanline(&pixel_state, dptr + offset, sptr + offset, count);
+                }
+            }
+        } else
+        if (vectorized) {
+            GL_simd_copy(dptr, sptr, width, fingerprint->keys, fingerprint->transparent);
+        } else {
+            scanline(&pixel_state, dptr, sptr, width);
+        }
 
-    const int sskip = swidth - width;
-    const int dskip = dwidth - width;
-#ifdef __GL_MASK_SUPPORT__
-    if (mask->stencil) {
-        const GL_Surface_t *stencil = mask->stencil;
-        const GL_Pixel_t threshold = mask->threshold;
+        sptr += sstride;
+        dptr += dstride;
+    }
+}
 
-        const GL_Pixel_t *mptr = stencil->data_rows[area.y + skip_y] + (area.x + skip_x);
+// The area is described by its opaque spans (which are precomputed for a given shifting/transparent state), so
+// that transparent pixels are skipped altogether and opaque ones are copied in runs. It's up to the caller to
+// ensure that the current state matches the one the spans were built for.
+void GL_context_blit_spans(const GL_Context_t *context, const GL_Surface_t *surface, const GL_Spans_t *spans, GL_Rectangle_t area, GL_Point_t position)
+{
+    if (context->queue) {
+        GL_queue_blit_spans(context->queue, &context->state, surface, spans, area, position);
+        return;
+    }
 
-        const int mskip = stencil->width - width;
+    const GL_State_t *state = &context->state;
+    const GL_Quad_t *clipping_region = &state->clipping_region;
 
-        for (int i = height; i; --i) {
-            for (int j = width; j; --j) {
-#ifdef __DEBUG_GRAPHICS__
-                pixel(context, drawing_region.x0 + width - j, drawing_region.y0 + height - i, (int)i + (int)j);
-#endif
-                GL_Pixel_t index = shifting[*(sptr++)];
-                GL_Pixel_t mask = *(mptr++);
-                if (transparent[index] || (mask < threshold)) {
-                    dptr++;
+    GL_Quad_t drawing_region = (GL_Quad_t){
+            .x0 = position.x,
+            .y0 = position.y,
+            .x1 = position.x + area.width - 1,
+            .y1 = position.y + area.height - 1
+        };
+
+    int skip_x = 0; // Offset into the (source) surface/texture, update during clipping.
+    int skip_y = 0;
+
+    if (drawing_region.x0 < clipping_region->x0) {
+        skip_x = clipping_region->x0 - drawing_region.x0;
+        drawing_region.x0 = clipping_region->x0;
+    }
+    if (drawing_region.y0 < clipping_region->y0) {
+        skip_y = clipping_region->y0 - drawing_region.y0;
+        drawing_region.y0 = clipping_region->y0;
+    }
+    if (drawing_region.x1 > clipping_region->x1) {
+        drawing_region.x1 = clipping_region->x1;
+    }
+    if (drawing_region.y1 > clipping_region->y1) {
+        drawing_region.y1 = clipping_region->y1;
+    }
+
+    const int width = drawing_region.x1 - drawing_region.x0 + 1;
+    const int height = drawing_region.y1 - drawing_region.y0 + 1;
+    if ((width <= 0) || (height <= 0)) { // Nothing to draw! Bail out!
+        return;
+    }
+
+    GL_surface_touch(state->surface, drawing_region.y0, drawing_region.y1);
+
+    const GL_Pixel_t *sdata = surface->data;
+    GL_Pixel_t *ddata = state->surface->data;
+
+    const int sstride = surface->stride;
+    const int dstride = state->surface->stride;
+
+    const GL_Pixel_t *sptr = sdata + (area.y + skip_y) * sstride + area.x; // Spans are relative to the area left edge.
+    GL_Pixel_t *dptr = ddata + drawing_region.y0 * dstride + drawing_region.x0;
+
+    const int min_x = skip_x; // Visible columns range, relative to the area.
+    const int max_x = skip_x + width;
+
+    const GL_Span_t *span_data = spans->spans;
+    const size_t *rows = spans->rows + skip_y;
+
+    for (int i = height; i; --i) {
+        const GL_Span_t *span = span_data + rows[0];
+        const GL_Span_t *eos = span_data + rows[1];
+
+        for (int x = 0; span < eos; ++span) {
+            int x0 = x + span->skip;
+            int x1 = x0 + span->count;
+            x = x1;
+
+            if (x1 <= min_x) {
+                continue;
+            }
+            if (x0 >= max_x) {
+                break;
+            }
+            if (x0 < min_x) {
+                x0 = min_x;
+            }
+            if (x1 > max_x) {
+                x1 = max_x;
+            }
+            memcpy(dptr + (x0 - min_x), sptr + x0, x1 - x0);
+        }
+
+        ++rows;
+        sptr += sstride;
+        dptr += dstride;
+    }
+}
+
+// Whether the source rows can be expanded in a line buffer and copied, with no per-pixel lookups.
+static inline bool is_expandable(const GL_Fingerprint_t *fingerprint, int width)
+{
+    return !fingerprint->blended && !fingerprint->shaded && fingerprint->transparent <= GL_SIMD_MAX_KEYS && width <= GL_BLIT_LINE_LENGTH;
+}
+
+// Integer scaling factors (possibly negative, i.e. flipping) are handled by replicating each source pixel `scale_x`
+// times, and each source row `scale_y` times, with no per-pixel arithmetic at all. Since a clipped source pixel
+// (or row) can be partially visible, the replica counters are initialized accordingly.
+static void blit_s_integer(const GL_Context_t *context, const GL_Surface_t *surface, GL_Rectangle_t area, const GL_Quad_t *drawing_region, int skip_x, int skip_y, int scale_x, int scale_y)
+{
+    const GL_State_t *state = &context->state;
+    const GL_Pixel_t *shifting = state->shifting;
+    const GL_Bool_t *transparent = state->transparent;
+    const GL_Pixel_t *blending = state->blending;
+
+    const int width = drawing_region->x1 - drawing_region->x0 + 1;
+    const int height = drawing_region->y1 - drawing_region->y0 + 1;
+
+    const int sx = scale_x < 0 ? -scale_x : scale_x;
+    const int sy = scale_y < 0 ? -scale_y : scale_y;
+    const int du = scale_x < 0 ? -1 : 1;
+    const int dv = scale_y < 0 ? -(int)surface->stride : (int)surface->stride;
+
+    const int u = scale_x < 0 ? area.x + (int)area.width - 1 - skip_x / sx : area.x + skip_x / sx;
+    const int v = scale_y < 0 ? area.y + (int)area.height - 1 - skip_y / sy : area.y + skip_y / sy;
+    const int ru = sx - skip_x % sx; // Replicas of the first (clipped) column and row.
+    int rv = sy - skip_y % sy;
+
+    const GL_Pixel_t *sptr = surface->data + v * surface->stride + u;
+
+    const int dstride = state->surface->stride;
+    GL_Pixel_t *dptr = state->surface->data + drawing_region->y0 * dstride + drawing_region->x0;
+
+    const int dskip = dstride - width;
+
+    const GL_Fingerprint_t *fingerprint = &state->fingerprint;
+    if (is_expandable(fingerprint, width)) { // Expand (and shift) each source row once, then copy it.
+        GL_Pixel_t line[GL_BLIT_LINE_LENGTH];
+        const int head = ru < width ? ru : width; // Partially clipped first column, whole columns, and clipped last one.
+        const int columns = (width - head) / sx;
+        const int tail = (width - head) % sx;
+        for (int i = height; i; ) {
+            const GL_Pixel_t *srow = sptr;
+            GL_Pixel_t *lptr = line;
+
+            memset(lptr, shifting[*srow], head);
+            lptr += head;
+            srow += du;
+
+            switch (sx) { // Specialize the most common factors, so that the compiler can unroll the stores.
+                case 1:
+                    for (int j = columns; j; --j) {
+                        *(lptr++) = shifting[*srow];
+                        srow += du;
+                    }
+                    break;
+                case 2:
+                    for (int j = columns; j; --j) {
+                        const GL_Pixel_t index = shifting[*srow];
+                        lptr[0] = lptr[1] = index;
+                        lptr += 2;
+                        srow += du;
+                    }
+                    break;
+                case 3:
+                    for (int j = columns; j; --j) {
+                        const GL_Pixel_t index = shifting[*srow];
+                        lptr[0] = lptr[1] = lptr[2] = index;
+                        lptr += 3;
+                        srow += du;
+                    }
+                    break;
+                case 4:
+                    for (int j = columns; j; --j) {
+                        const GL_Pixel_t index = shifting[*srow];
+                        lptr[0] = lptr[1] = lptr[2] = lptr[3] = index;
+                        lptr += 4;
+                        srow += du;
+                    }
+                    break;
+                default:
+                    for (int j = columns; j; --j) {
+                        memset(lptr, shifting[*srow], sx);
+                        lptr += sx;
+                        srow += du;
+                    }
+                    break;
+            }
+
+            if (tail) {
+                memset(lptr, shifting[*srow], tail);
+            }
+
+            for (int n = rv < i ? rv : i; n; --n) {
+                if (fingerprint->masked) {
+                    Mask_Runs_t runs;
+                    mask_runs(&runs, state, drawing_region->x0, drawing_region->y1 + 1 - i, width);
+                    for (int offset, count; mask_next_run(&runs, &offset, &count); ) {
+                        GL_simd_copy(dptr + offset, line + offset, count, fingerprint->keys, fingerprint->transparent);
+                    }
                 } else {
-                    *(dptr++) = index;
+                    GL_simd_copy(dptr, line, width, fingerprint->keys, fingerprint->transparent);
                 }
+                dptr += dstride;
+                --i;
             }
-            sptr += sskip;
-            mptr += mskip;
-            dptr += dskip;
+
+            sptr += dv;
+            rv = sy;
         }
-    } else {
-#endif
-        for (int i = height; i; --i) {
-            for (int j = width; j; --j) {
-#ifdef __DEBUG_GRAPHICS__
-                pixel(context, drawing_region.x0 + width - j, drawing_region.y0 + height - i, (int)i + (int)j);
-#endif
-                GL_Pixel_t index = shifting[*(sptr++)];
-                if (transparent[index]) {
+        return;
+    }
+
+    Pixel_State_t pixel_state;
+    select_variant(state, &pixel_state);
+
+    for (int i = height; i; --i) {
+        shade_row(&pixel_state, dptr);
+
+        const GL_Pixel_t *srow = sptr;
+        int r = ru;
+        for (int j = width; j; ) {
+            GL_Pixel_t index = shifting[*srow];
+            srow += du;
+
+            int n = r < j ? r : j;
+            j -= n;
+            r = sx;
+
+            if (transparent[index]) {
+                dptr += n;
+            } else if (pixel_state.shades) {
+                for (; n; --n) {
+                    const GL_Pixel_t shaded = shade(&pixel_state, dptr)[index];
+                    *dptr = blending ? blending[shaded * GL_MAX_PALETTE_COLORS + *dptr] : shaded;
                     dptr++;
-                } else {
+                }
+            } else if (blending) {
+                const GL_Pixel_t *row = blending + index * GL_MAX_PALETTE_COLORS;
+                for (; n; --n) {
+                    *dptr = row[*dptr];
+                    dptr++;
+                }
+            } else {
+                for (; n; --n) {
                     *(dptr++) = index;
                 }
             }
-            sptr += sskip;
-            dptr += dskip;
         }
-#ifdef __GL_MASK_SUPPORT__
+
+        dptr += dskip;
+
+        if (--rv == 0) {
+            sptr += dv;
+            rv = sy;
+        }
     }
-#endif
+}
+
+typedef void (*Blit_S_Scanline_t)(const Pixel_State_t *pixel_state, GL_Pixel_t *dptr, const GL_Pixel_t *sptr, int width, fixed_t u, fixed_t du);
+
+#define DEFINE_BLIT_S_SCANLINE(variant) \
+    static void blit_s_scanline_##variant(const Pixel_State_t *pixel_state, GL_Pixel_t *dptr, const GL_Pixel_t *sptr, int width, fixed_t u, fixed_t du) \
+    { \
+        for (int j = width; j; --j) { \
+            const int x = FIXED_TO_INT(u); \
+            PIXEL_##variant(pixel_state, dptr, sptr[x < 0 ? 0 : x]); \
+            ++dptr; \
+            u += du; \
+        } \
+    }
+
+DEFINE_BLIT_S_SCANLINE(generic)
+DEFINE_BLIT_S_SCANLINE(keyed)
+DEFINE_BLIT_S_SCANLINE(opaque)
+DEFINE_BLIT_S_SCANLINE(blended)
+DEFINE_BLIT_S_SCANLINE(shaded)
+
+static const Blit_S_Scanline_t _blit_s_scanlines[Variants_t_CountOf] = {
+    blit_s_scanline_generic,
+    blit_s_scanline_keyed,
+    blit_s_scanline_opaque,
+    blit_s_scanline_blended,
+    blit_s_scanline_shaded
+};
+
+// Compute the 16.16 fixed-point starting texture coordinate (relative to the area origin) and step for a `length`
+// texels long area, scaled by `scale` (flipping when negative) to `drawn` destination pixels, with `clip` of them
+// already skipped. The step is rounded up so that exact texel boundaries (e.g. every third pixel when scaling by 1.5)
+// aren't missed due to precision loss. If this would overshoot the area end, we round it down instead. The check is
+// done on the whole (unclipped) drawn length, so that the sampling doesn't depend on the clipping region.
+static inline void fixed_dda(int length, float scale, int clip, int drawn, fixed_t *start, fixed_t *step)
+{
+    fixed_t delta = (fixed_t)ceilf((float)FIXED_ONE / scale);
+    fixed_t origin = scale < 0.0f ? FIXED_FROM_INT(length) + delta : 0; // Move to last pixel, scaled, into the texture.
+    if ((scale > 0.0f) && ((int64_t)origin + (int64_t)(drawn - 1) * delta >= (int64_t)FIXED_FROM_INT(length))) {
+        delta -= 1;
+    }
+    *start = origin + clip * delta;
+    *step = delta;
 }
 
 // Simple implementation of nearest-neighbour scaling, with x/y flipping according to scaling-factor sign.
@@ -146,13 +640,13 @@ void GL_context_blit(const GL_Context_t *context, const GL_Surface_t *surface, G
 // To avoid empty pixels we scan the destination area and calculate the source pixel.
 void GL_context_blit_s(const GL_Context_t *context, const GL_Surface_t *surface, GL_Rectangle_t area, GL_Point_t position, float scale_x, float scale_y)
 {
+    if (context->queue) {
+        GL_queue_blit_s(context->queue, &context->state, surface, area, position, scale_x, scale_y);
+        return;
+    }
+
     const GL_State_t *state = &context->state;
     const GL_Quad_t *clipping_region = &state->clipping_region;
-    const GL_Pixel_t *shifting = state->shifting;
-    const GL_Bool_t *transparent = state->transparent;
-#ifdef __GL_MASK_SUPPORT__
-    const GL_Mask_t *mask = &state->mask;
-#endif
 
     const int drawing_width = (int)((float)(area.width * fabsf(scale_x)) + 0.5f);
     const int drawing_height = (int)((float)(area.height * fabsf(scale_y)) + 0.5f);
@@ -164,15 +658,15 @@ void GL_context_blit_s(const GL_Context_t *context, const GL_Surface_t *surface,
             .y1 = position.y + drawing_height - 1,
         };
 
-    float skip_x = 0.0f; // Offset into the (source) surface/texture, update during clipping.
-    float skip_y = 0.0f;
+    int clip_x = 0; // Clipped (destination) pixels, to be converted to texture offsets.
+    int clip_y = 0;
 
     if (drawing_region.x0 < clipping_region->x0) {
-        skip_x = (float)(clipping_region->x0 - drawing_region.x0) / scale_x;
+        clip_x = clipping_region->x0 - drawing_region.x0;
         drawing_region.x0 = clipping_region->x0;
     }
     if (drawing_region.y0 < clipping_region->y0) {
-        skip_y = (float)(clipping_region->y0 - drawing_region.y0) / scale_y;
+        clip_y = clipping_region->y0 - drawing_region.y0;
         drawing_region.y0 = clipping_region->y0;
     }
     if (drawing_region.x1 > clipping_region->x1) {
@@ -188,96 +682,132 @@ void GL_context_blit_s(const GL_Context_t *context, const GL_Surface_t *surface,
         return;
     }
 
-    const GL_Pixel_t *sdata = surface->data;
-    GL_Pixel_t *ddata = state->surface->data;
+    GL_surface_touch(state->surface, drawing_region.y0, drawing_region.y1);
 
-    const int swidth = surface->width;
-    const int dwidth = state->surface->width;
+    // The masked run-length loop isn't supported, fall back to the generic scanline in that case.
+    const int integer_x = (int)scale_x;
+    const int integer_y = (int)scale_y;
+    if ((float)integer_x == scale_x && (float)integer_y == scale_y && (!state->fingerprint.masked || is_expandable(&state->fingerprint, width))) {
+        blit_s_integer(context, surface, area, &drawing_region, clip_x, clip_y, integer_x, integer_y);
+        return;
+    }
 
-    GL_Pixel_t *dptr = ddata + drawing_region.y0 * dwidth + drawing_region.x0;
+    const GL_Pixel_t *sdata = surface->data;
+    GL_Pixel_t *ddata = state->surface->data;
 
-    const size_t dskip = dwidth - width;
+    const int sstride = surface->stride;
+    const int dstride = state->surface->stride;
 
-    const float du = 1.0f / scale_x; // Texture coordinates deltas (signed).
-    const float dv = 1.0f / scale_y;
+    GL_Pixel_t *dptr = ddata + drawing_region.y0 * dstride + drawing_region.x0;
 
-    float ou = (float)area.x + skip_x;
-    if (scale_x < 0.0f) {
-        ou += (float)area.width + du; // Move to last pixel, scaled, into the texture.
-    }
-    float ov = (float)area.y + skip_y;
-    if (scale_y < 0.0f) {
-        ov += (float)area.height + dv;
-    }
-    // NOTE: we can also apply an integer-based DDA method, using remainders.
+    // Step in 16.16 fixed-point, with coordinates relative to the area origin. When flipping, the last pixel
+    // could fall (by a fraction of a texel) before the origin, hence the clamping to zero.
+    fixed_t ou, du, ov, dv;
+    fixed_dda(area.width, scale_x, clip_x, drawing_width, &ou, &du);
+    fixed_dda(area.height, scale_y, clip_y, drawing_height, &ov, &dv);
 
-#ifdef __GL_MASK_SUPPORT__
-    if (mask->stencil) {
-        const GL_Surface_t *stencil = mask->stencil;
-        const GL_Pixel_t threshold = mask->threshold;
+    Pixel_State_t pixel_state;
+    const Blit_S_Scanline_t scanline = _blit_s_scanlines[select_variant(state, &pixel_state)];
 
-        float v = ov;
-        for (int i = height; i; --i) {
-            const GL_Pixel_t *sptr = surface->data_rows[(int)v];
-            const GL_Pixel_t *mptr = stencil->data_rows[(int)v];
+    const GL_Pixel_t *sorigin = sdata + area.y * sstride + area.x;
 
-            float u = ou;
-            for (int j = width; j; --j) {
-#ifdef __DEBUG_GRAPHICS__
-                pixel(context, drawing_region.x0 + width - j, drawing_region.y0 + height - i, (int)u + (int)v);
-#endif
-                GL_Pixel_t index = shifting[sptr[(int)u]];
-                GL_Pixel_t mask = mptr[(int)u];
-                if (transparent[index] || (mask < threshold)) {
-                    dptr++;
-                } else {
-                    *(dptr++) = index;
-                }
-                u += du;
+    fixed_t v = ov;
+    for (int i = 0; i < height; ++i) {
+        const int y = FIXED_TO_INT(v);
+        const GL_Pixel_t *srow = sorigin + (y < 0 ? 0 : y) * sstride;
+        shade_row(&pixel_state, dptr);
+        if (state->fingerprint.masked) {
+            Mask_Runs_t runs;
+            mask_runs(&runs, state, drawing_region.x0, drawing_region.y0 + i, width);
+            for (int offset, count; mask_next_run(&runs, &offset, &count); ) {
+                scanline(&pixel_state, dptr + offset, srow, count, ou + offset * du, du);
             }
-
-            v += dv;
-            dptr += dskip;
+        } else {
+            scanline(&pixel_state, dptr, srow, width, ou, du);
         }
-    } else {
-#endif
-        float v = ov;
-        for (int i = height; i; --i) {
-            const GL_Pixel_t *sptr = sdata + (int)v * swidth;
 
-            float u = ou;
-            for (int j = width; j; --j) {
-#ifdef __DEBUG_GRAPHICS__
-                pixel(context, drawing_region.x0 + width - j, drawing_region.y0 + height - i, (int)u + (int)v);
-#endif
-                GL_Pixel_t index = shifting[sptr[(int)u]];
-                if (transparent[index]) {
-                    dptr++;
-                } else {
-                    *(dptr++) = index;
-                }
-                u += du;
-            }
+        v += dv;
+        dptr += dstride;
+    }
+}
+
+static inline int64_t floor_div(int64_t a, int64_t b) // Assumes `b > 0`.
+{
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+static inline int64_t ceil_div(int64_t a, int64_t b)
+{
+    return a >= 0 ? (a + b - 1) / b : -(-a / b);
+}
 
-            v += dv;
-            dptr += dskip;
+// Narrow the `[*x0, *x1]` range to the values of `x` for which `o + x * d` falls in the `[min, max)` range. Since
+// the function is linear (and we use exact integer arithmetic) the result is an interval, possibly empty.
+static inline void span_range(fixed64_t o, fixed64_t d, fixed64_t min, fixed64_t max, int *x0, int *x1)
+{
+    int64_t from, to;
+    if (d > 0) { // `x >= (min - o) / d` and `x < (max - o) / d`
+        from = ceil_div(min - o, d);
+        to = ceil_div(max - o, d) - 1;
+    } else
+    if (d < 0) { // Same as above, but the inequalities flip.
+        from = floor_div(o - max, -d) + 1;
+        to = floor_div(o - min, -d);
+    } else {
+        if (o >= min && o < max) {
+            return;
         }
-#ifdef __GL_MASK_SUPPORT__
+        from = 1;
+        to = 0;
+    }
+    if (*x0 < from) {
+        *x0 = (int)(from > *x1 + 1 ? *x1 + 1 : from);
+    }
+    if (*x1 > to) {
+        *x1 = (int)(to < *x0 - 1 ? *x0 - 1 : to);
     }
-#endif
 }
 
+// Draw `count` pixels (if positive) along a texture line. No bound check is done, it's up to the caller to ensure
+// the coordinates don't fall outside the texture.
+typedef void (*Texture_Scanline_t)(const Pixel_State_t *pixel_state, GL_Pixel_t *dptr, const GL_Pixel_t *sdata, int sstride, int count, fixed64_t u, fixed64_t v, fixed64_t du, fixed64_t dv);
+
+#define DEFINE_TEXTURE_SCANLINE(variant) \
+    static void texture_scanline_##variant(const Pixel_State_t *pixel_state, GL_Pixel_t *dptr, const GL_Pixel_t *sdata, int sstride, int count, fixed64_t u, fixed64_t v, fixed64_t du, fixed64_t dv) \
+    { \
+        for (int j = count; j > 0; --j) { \
+            PIXEL_##variant(pixel_state, dptr, sdata[FIXED64_TO_INT(v) * sstride + FIXED64_TO_INT(u)]); \
+            ++dptr; \
+            u += du; \
+            v += dv; \
+        } \
+    }
+
+DEFINE_TEXTURE_SCANLINE(generic)
+DEFINE_TEXTURE_SCANLINE(keyed)
+DEFINE_TEXTURE_SCANLINE(opaque)
+DEFINE_TEXTURE_SCANLINE(blended)
+DEFINE_TEXTURE_SCANLINE(shaded)
+
+static const Texture_Scanline_t _texture_scanlines[Variants_t_CountOf] = {
+    texture_scanline_generic,
+    texture_scanline_keyed,
+    texture_scanline_opaque,
+    texture_scanline_blended,
+    texture_scanline_shaded
+};
+
 // https://web.archive.org/web/20190305223938/http://www.drdobbs.com/architecture-and-design/fast-bitmap-rotation-and-scaling/184416337
 // https://www.flipcode.com/archives/The_Art_of_Demomaking-Issue_10_Roto-Zooming.shtml
 void GL_context_blit_sr(const GL_Context_t *context, const GL_Surface_t *surface, GL_Rectangle_t area, GL_Point_t position, float scale_x, float scale_y, int rotation, float anchor_x, float anchor_y)
 {
+    if (context->queue) {
+        GL_queue_blit_sr(context->queue, &context->state, surface, area, position, scale_x, scale_y, rotation, anchor_x, anchor_y);
+        return;
+    }
+
     const GL_State_t *state = &context->state;
     const GL_Quad_t *clipping_region = &state->clipping_region;
-    const GL_Pixel_t *shifting = state->shifting;
-    const GL_Bool_t *transparent = state->transparent;
-#ifdef __GL_MASK_SUPPORT__
-    const GL_Mask_t *mask = &state->mask;
-#endif
 
     const float w = (float)area.width;
     const float h = (float)area.height;
@@ -338,6 +868,7 @@ void GL_context_blit_sr(const GL_Context_t *context, const GL_Surface_t *surface
             .x1 = (int)(fmax(fmax(fmax(x0, x1), x2), x3) + dx),
             .y1 = (int)(fmax(fmax(fmax(y0, y1), y2), y3) + dy)
         };
+    const GL_Point_t aabb_origin = (GL_Point_t){ .x = drawing_region.x0, .y = drawing_region.y0 };
 
     if (drawing_region.x0 < clipping_region->x0) {
         drawing_region.x0 = clipping_region->x0;
@@ -358,6 +889,8 @@ void GL_context_blit_sr(const GL_Context_t *context, const GL_Surface_t *surface
         return;
     }
 
+    GL_surface_touch(state->surface, drawing_region.y0, drawing_region.y1);
+
     const int sminx = area.x;
     const int sminy = area.y;
     const int smaxx = area.x + area.width - 1;
@@ -368,105 +901,187 @@ void GL_context_blit_sr(const GL_Context_t *context, const GL_Surface_t *surface
     const float M21 = -s / scale_y; // |           | |      |
     const float M22 = c / scale_y;  // |    0 1/sy | | -s c |
 
-    const float tlx = (float)drawing_region.x0 - dx; // Transform the top-left corner of the to-be-drawn rectangle to texture space.
-    const float tly = (float)drawing_region.y0 - dy; // (could differ from AABB x0 due to clipping, we need to compute it again)
-    float ou = (tlx * M11 + tly * M12) + sax + sx; // Offset to the source texture quad.
-    float ov = (tlx * M21 + tly * M22) + say + sy;
-
     const GL_Pixel_t *sdata = surface->data;
     GL_Pixel_t *ddata = state->surface->data;
 
-    const int swidth = surface->width;
-    const int dwidth = state->surface->width;
-
-    GL_Pixel_t *dptr = ddata + drawing_region.y0 * dwidth + drawing_region.x0;
-
-    const int dskip = dwidth - width;
-
-#ifdef __GL_MASK_SUPPORT__
-    if (mask->stencil) {
-        const GL_Surface_t *stencil = mask->stencil;
-        const GL_Pixel_t threshold = mask->threshold;
-
-        for (int i = height; i; --i) {
-            float u = ou;
-            float v = ov;
+    const int sstride = surface->stride;
+    const int dstride = state->surface->stride;
+
+    GL_Pixel_t *dptr = ddata + drawing_region.y0 * dstride + drawing_region.x0;
+
+    // Rather than testing each pixel of the AABB against the source area, we compute (for each scanline) the
+    // span of columns that falls into it, and step in (32.32) fixed-point only inside of it. Both the span and
+    // the texture coordinates are computed with the same fixed-point values, so no bound check is required.
+    const fixed64_t du = FIXED64_FROM_FLOAT(M11);
+    const fixed64_t dv = FIXED64_FROM_FLOAT(M21);
+    const fixed64_t du_row = FIXED64_FROM_FLOAT(M12);
+    const fixed64_t dv_row = FIXED64_FROM_FLOAT(M22);
+
+    // Transform the top-left corner of the (unclipped) AABB to texture space, then step to the clipped one in
+    // fixed-point. This way the texture coordinates of a pixel don't depend on the clipping region.
+    const float tlx = (float)aabb_origin.x - dx;
+    const float tly = (float)aabb_origin.y - dy;
+    fixed64_t ou = FIXED64_FROM_FLOAT((tlx * M11 + tly * M12) + sax + sx) // Offset to the source texture quad.
+        + (drawing_region.x0 - aabb_origin.x) * du + (drawing_region.y0 - aabb_origin.y) * du_row;
+    fixed64_t ov = FIXED64_FROM_FLOAT((tlx * M21 + tly * M22) + say + sy)
+        + (drawing_region.x0 - aabb_origin.x) * dv + (drawing_region.y0 - aabb_origin.y) * dv_row;
+
+    const fixed64_t min_u = FIXED64_FROM_INT(sminx);
+    const fixed64_t max_u = FIXED64_FROM_INT(smaxx + 1); // Excluded.
+    const fixed64_t min_v = FIXED64_FROM_INT(sminy);
+    const fixed64_t max_v = FIXED64_FROM_INT(smaxy + 1);
+
+    Pixel_State_t pixel_state;
+    const Texture_Scanline_t scanline = _texture_scanlines[select_variant(state, &pixel_state)];
+
+    for (int i = height; i; --i) {
+        const fixed64_t u0 = ou;
+        const fixed64_t v0 = ov;
+
+        int x0 = 0, x1 = width - 1;
+        span_range(u0, du, min_u, max_u, &x0, &x1);
+        span_range(v0, dv, min_v, max_v, &x0, &x1);
+
+        shade_row(&pixel_state, dptr);
+        if (state->fingerprint.masked) {
+            Mask_Runs_t runs;
+            mask_runs(&runs, state, drawing_region.x0 + x0, drawing_region.y1 + 1 - i, x1 - x0 + 1);
+            for (int offset, count; mask_next_run(&runs, &offset, &count); ) {
+                const int x = x0 + offset;
+                scanline(&pixel_state, dptr + x, sdata, sstride, count, u0 + x * du, v0 + x * dv, du, dv);
+            }
+        } else {
+            scanline(&pixel_state, dptr + x0, sdata, sstride, x1 - x0 + 1, u0 + x0 * du, v0 + x0 * dv, du, dv);
+        }
 
-            for (int j = width; j; --j) {
-#ifdef __DEBUG_GRAPHICS__
-                pixel(context, drawing_region.x0 + width - j, drawing_region.y0 + height - i, 15);
-#endif
-                int x = (int)floorf(u); // Round down, to preserve negative values as such (e.g. `-0.3` is `-1`) and avoid mirror effect.
-                int y = (int)floorf(v);
+        dptr += dstride;
 
-                if (x >= sminx && x <= smaxx && y >= sminy && y <= smaxy) {
+        ou += du_row;
+        ov += dv_row;
+    }
 #ifdef __DEBUG_GRAPHICS__
-                    pixel(context, drawing_region.x0 + width - j, drawing_region.y0 + height - i, i + j);
+    pixel(context, drawing_region.x0, drawing_region.y0, 7);
+    pixel(context, drawing_region.x1, drawing_region.y0, 7);
+    pixel(context, drawing_region.x1, drawing_region.y1, 7);
+    pixel(context, drawing_region.x0, drawing_region.y1, 7);
 #endif
-                    const GL_Pixel_t *sptr = surface->data_rows[y] + x;
-                    const GL_Pixel_t *mptr = stencil->data_rows[y] + x;
-                    GL_Pixel_t index = shifting[*sptr];
-                    GL_Pixel_t mask = *mptr;
-                    if (transparent[index] || (mask < threshold)) {
-                        *dptr = index;
-                    }
-                }
+}
 
-                ++dptr;
+typedef struct _XForm_Scanline_t {
+    const GL_Pixel_t *data;
+    int width, height;
+    int stride;
+    Pixel_State_t pixel_state;
+    Texture_Scanline_t texture_scanline;
+} XForm_Scanline_t;
 
-                u += M11;
-                v += M21;
-            }
+typedef void (*XForm_Scanline_Function_t)(const XForm_Scanline_t *scanline, GL_Pixel_t *dptr, int width, fixed64_t u, fixed64_t v, fixed64_t du, fixed64_t dv);
 
-            dptr += dskip;
-
-            ou += M12;
-            ov += M22;
-        }
-    } else {
-#endif
-        for (int i = height; i; --i) {
-            float u = ou;
-            float v = ov;
-
-            for (int j = width; j; --j) {
-#ifdef __DEBUG_GRAPHICS__
-                pixel(context, drawing_region.x0 + width - j, drawing_region.y0 + height - i, 15);
-#endif
-                int x = (int)floorf(u); // Round down, to preserve negative values as such (e.g. `-0.3` is `-1`) and avoid mirror effect.
-                int y = (int)floorf(v);
+static inline fixed64_t fixed64_wrap(fixed64_t value, fixed64_t period)
+{
+    value %= period;
+    return value < 0 ? value + period : value;
+}
 
-                if (x >= sminx && x <= smaxx && y >= sminy && y <= smaxy) {
-#ifdef __DEBUG_GRAPHICS__
-                    pixel(context, drawing_region.x0 + width - j, drawing_region.y0 + height - i, i + j);
-#endif
-                    const GL_Pixel_t *sptr = sdata + y * swidth + x;
-                    GL_Pixel_t index = shifting[*sptr];
-                    if (!transparent[index]) {
-                        *dptr = index;
-                    }
-                }
+// One kernel for each clamping mode, so that the inner loop is branch-free (the transparency check aside). Texture
+// coordinates are 32.32 fixed-point values, already biased by half a texel so that rounding is a plain shift.
+//
+// Power-of-two textures wrap around with a bit-mask (which works for negative values, too). Generic textures wrap
+// around incrementally: both the coordinates and the steps are reduced to the `[0, size)` range beforehand, so that
+// a single subtraction is enough to wrap at each step.
+#define DEFINE_XFORM_SCANLINES(variant) \
+    static void xform_scanline_edge_##variant(const XForm_Scanline_t *scanline, GL_Pixel_t *dptr, int width, fixed64_t u, fixed64_t v, fixed64_t du, fixed64_t dv) \
+    { \
+        const GL_Pixel_t *sdata = scanline->data; \
+        const int sstride = scanline->stride; \
+        const int smaxx = scanline->width - 1; \
+        const int smaxy = scanline->height - 1; \
+        for (int j = width; j; --j) { \
+            int x = FIXED64_TO_INT(u); \
+            int y = FIXED64_TO_INT(v); \
+            x = x < 0 ? 0 : (x > smaxx ? smaxx : x); \
+            y = y < 0 ? 0 : (y > smaxy ? smaxy : y); \
+            PIXEL_##variant(&scanline->pixel_state, dptr, sdata[y * sstride + x]); \
+            ++dptr; \
+            u += du; \
+            v += dv; \
+        } \
+    } \
+    \
+    static void xform_scanline_repeat_pot_##variant(const XForm_Scanline_t *scanline, GL_Pixel_t *dptr, int width, fixed64_t u, fixed64_t v, fixed64_t du, fixed64_t dv) \
+    { \
+        const GL_Pixel_t *sdata = scanline->data; \
+        const int sstride = scanline->stride; \
+        const int mask_x = scanline->width - 1; \
+        const int mask_y = scanline->height - 1; \
+        for (int j = width; j; --j) { \
+            const int x = FIXED64_TO_INT(u) & mask_x; \
+            const int y = FIXED64_TO_INT(v) & mask_y; \
+            PIXEL_##variant(&scanline->pixel_state, dptr, sdata[y * sstride + x]); \
+            ++dptr; \
+            u += du; \
+            v += dv; \
+        } \
+    } \
+    \
+    static void xform_scanline_repeat_##variant(const XForm_Scanline_t *scanline, GL_Pixel_t *dptr, int width, fixed64_t u, fixed64_t v, fixed64_t du, fixed64_t dv) \
+    { \
+        const GL_Pixel_t *sdata = scanline->data; \
+        const int sstride = scanline->stride; \
+        const fixed64_t period_u = FIXED64_FROM_INT(scanline->width); \
+        const fixed64_t period_v = FIXED64_FROM_INT(scanline->height); \
+        u = fixed64_wrap(u, period_u); \
+        v = fixed64_wrap(v, period_v); \
+        du = fixed64_wrap(du, period_u); \
+        dv = fixed64_wrap(dv, period_v); \
+        for (int j = width; j; --j) { \
+            PIXEL_##variant(&scanline->pixel_state, dptr, sdata[FIXED64_TO_INT(v) * sstride + FIXED64_TO_INT(u)]); \
+            ++dptr; \
+            u += du; \
+            if (u >= period_u) { \
+                u -= period_u; \
+            } \
+            v += dv; \
+            if (v >= period_v) { \
+                v -= period_v; \
+            } \
+        } \
+    }
 
-                ++dptr;
+DEFINE_XFORM_SCANLINES(generic)
+DEFINE_XFORM_SCANLINES(keyed)
+DEFINE_XFORM_SCANLINES(opaque)
+DEFINE_XFORM_SCANLINES(blended)
+DEFINE_XFORM_SCANLINES(shaded)
 
-                u += M11;
-                v += M21;
-            }
+// Pixels outside the texture are not drawn, so (as for rotations) we compute the covered span in advance.
+static void xform_scanline_border(const XForm_Scanline_t *scanline, GL_Pixel_t *dptr, int width, fixed64_t u, fixed64_t v, fixed64_t du, fixed64_t dv)
+{
+    int x0 = 0, x1 = width - 1;
+    span_range(u, du, 0, FIXED64_FROM_INT(scanline->width), &x0, &x1);
+    span_range(v, dv, 0, FIXED64_FROM_INT(scanline->height), &x0, &x1);
 
-            dptr += dskip;
+    scanline->texture_scanline(&scanline->pixel_state, dptr + x0, scanline->data, scanline->stride, x1 - x0 + 1, u + x0 * du, v + x0 * dv, du, dv);
+}
 
-            ou += M12;
-            ov += M22;
-        }
-#ifdef __GL_MASK_SUPPORT__
-    }
-#endif
-#ifdef __DEBUG_GRAPHICS__
-    pixel(context, drawing_region.x0, drawing_region.y0, 7);
-    pixel(context, drawing_region.x1, drawing_region.y0, 7);
-    pixel(context, drawing_region.x1, drawing_region.y1, 7);
-    pixel(context, drawing_region.x0, drawing_region.y1, 7);
-#endif
+typedef enum _XForm_Kernels_t {
+    XFORM_KERNEL_EDGE,
+    XFORM_KERNEL_BORDER,
+    XFORM_KERNEL_REPEAT,
+    XFORM_KERNEL_REPEAT_POT,
+    XForm_Kernels_t_CountOf
+} XForm_Kernels_t;
+
+static const XForm_Scanline_Function_t _xform_scanlines[XForm_Kernels_t_CountOf][Variants_t_CountOf] = {
+    { xform_scanline_edge_generic, xform_scanline_edge_keyed, xform_scanline_edge_opaque, xform_scanline_edge_blended, xform_scanline_edge_shaded },
+    { xform_scanline_border, xform_scanline_border, xform_scanline_border, xform_scanline_border, xform_scanline_border },
+    { xform_scanline_repeat_generic, xform_scanline_repeat_keyed, xform_scanline_repeat_opaque, xform_scanline_repeat_blended, xform_scanline_repeat_shaded },
+    { xform_scanline_repeat_pot_generic, xform_scanline_repeat_pot_keyed, xform_scanline_repeat_pot_opaque, xform_scanline_repeat_pot_blended, xform_scanline_repeat_pot_shaded }
+};
+
+static inline bool is_power_of_two(int value)
+{
+    return (value & (value - 1)) == 0;
 }
 
 // https://www.youtube.com/watch?v=3FVN_Ze7bzw
@@ -475,10 +1090,13 @@ void GL_context_blit_sr(const GL_Context_t *context, const GL_Surface_t *surface
 // https://www.smwcentral.net/?p=viewthread&t=27054
 void GL_context_blit_x(const GL_Context_t *context, const GL_Surface_t *surface, GL_Point_t position, const GL_XForm_t *xform)
 {
+    if (context->queue) {
+        GL_queue_blit_x(context->queue, &context->state, surface, position, xform);
+        return;
+    }
+
     const GL_State_t *state = &context->state;
     const GL_Quad_t *clipping_region = &state->clipping_region;
-    const GL_Pixel_t *shifting = state->shifting;
-    const GL_Bool_t *transparent = state->transparent;
 
     const int clamp = xform->clamp;
     const GL_XForm_Table_Entry_t *table = xform->table;
@@ -509,22 +1127,36 @@ void GL_context_blit_x(const GL_Context_t *context, const GL_Surface_t *surface,
         return;
     }
 
+    GL_surface_touch(state->surface, drawing_region.y0, drawing_region.y1);
+
     const int sw = surface->width;
     const int sh = surface->height;
-    const int sminx = 0;
-    const int sminy = 0;
-    const int smaxx = sw - 1;
-    const int smaxy = sh - 1;
 
-    const GL_Pixel_t *sdata = surface->data;
-    GL_Pixel_t *ddata = state->surface->data;
+    XForm_Kernels_t kernel;
+    if (clamp == GL_XFORM_CLAMP_REPEAT) {
+        kernel = is_power_of_two(sw) && is_power_of_two(sh) ? XFORM_KERNEL_REPEAT_POT : XFORM_KERNEL_REPEAT;
+    } else
+    if (clamp == GL_XFORM_CLAMP_EDGE) {
+        kernel = XFORM_KERNEL_EDGE;
+    } else {
+        kernel = XFORM_KERNEL_BORDER;
+    }
 
-    const int swidth = surface->width;
-    const int dwidth = state->surface->width;
+    XForm_Scanline_t scanline = (XForm_Scanline_t){
+            .data = surface->data,
+            .width = sw,
+            .height = sh,
+            .stride = (int)surface->stride
+        };
+    const Variants_t variant = select_variant(state, &scanline.pixel_state);
+    scanline.texture_scanline = _texture_scanlines[variant];
+    const XForm_Scanline_Function_t function = _xform_scanlines[kernel][variant];
 
-    GL_Pixel_t *dptr = ddata + drawing_region.y0 * dwidth + drawing_region.x0;
+    GL_Pixel_t *ddata = state->surface->data;
+
+    const int dstride = state->surface->stride;
 
-    const int dskip = dwidth - width;
+    GL_Pixel_t *dptr = ddata + drawing_region.y0 * dstride + drawing_region.x0;
 
     // The basic Mode7 formula is the following
     //
@@ -592,46 +1224,23 @@ void GL_context_blit_x(const GL_Context_t *context, const GL_Surface_t *surface,
         float yp = (c * xi + d * yi) + y0 + fmodf(v, sh);
 #endif
 
-        for (int j = 0; j < width; ++j) {
-#ifdef __DEBUG_GRAPHICS__
-            pixel(context, drawing_region.x0 + j, drawing_region.y0 + i, i + j);
-#endif
-            int sx = (int)(xp + 0.5f); // Round to avoid artifacts.
-            int sy = (int)(yp + 0.5f);
-
-            if (clamp == GL_XFORM_CLAMP_REPEAT) {
-                sx = imod(sx, sw);
-                sy = imod(sy, sh);
-            } else
-            if (clamp == GL_XFORM_CLAMP_EDGE) {
-                if (sx < sminx) {
-                    sx = sminx;
-                } else
-                if (sx > smaxx) {
-                    sx = smaxx;
-                }
-                if (sy < sminy) {
-                    sy = sminy;
-                } else
-                if (sy > smaxy) {
-                    sy = smaxy;
-                }
-            }
-
-            if (sx >= sminx && sx <= smaxx && sy >= sminy && sy <= smaxy) {
-                const GL_Pixel_t *sptr = sdata + sy * swidth + sx;
-                GL_Pixel_t index = shifting[*sptr];
-                if (!transparent[index]) {
-                    *dptr = index;
-                }
+        shade_row(&scanline.pixel_state, dptr);
+
+        // Bias by half a texel, so that flooring the coordinates rounds them to the nearest texel.
+        const fixed64_t u = FIXED64_FROM_FLOAT(xp + 0.5f);
+        const fixed64_t w = FIXED64_FROM_FLOAT(yp + 0.5f);
+        const fixed64_t du = FIXED64_FROM_FLOAT(a);
+        const fixed64_t dw = FIXED64_FROM_FLOAT(c);
+        if (state->fingerprint.masked) {
+            Mask_Runs_t runs;
+            mask_runs(&runs, state, drawing_region.x0, drawing_region.y0 + i, width);
+            for (int offset, count; mask_next_run(&runs, &offset, &count); ) {
+                function(&scanline, dptr + offset, count, u + offset * du, w + offset * dw, du, dw);
             }
-
-            ++dptr;
-
-            xp += a;
-            yp += c;
+        } else {
+            function(&scanline, dptr, width, u, w, du, dw);
         }
 
-        dptr += dskip;
+        dptr += dstride;
     }
 }
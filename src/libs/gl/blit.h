@@ -28,7 +28,17 @@
 #include "surface.h"
 #include "xform.h"
 
+typedef struct _GL_Span_t {
+    uint16_t skip, count; // Transparent pixels to skip, followed by opaque pixels to copy.
+} GL_Span_t;
+
+typedef struct _GL_Spans_t {
+    const GL_Span_t *spans;
+    const size_t *rows; // Row `i` spans are `spans[rows[i]]` up to (excluded) `spans[rows[i + 1]]`.
+} GL_Spans_t;
+
 extern void GL_context_blit(const GL_Context_t *context, const GL_Surface_t *surface, GL_Rectangle_t area, GL_Point_t position);
+extern void GL_context_blit_spans(const GL_Context_t *context, const GL_Surface_t *surface, const GL_Spans_t *spans, GL_Rectangle_t area, GL_Point_t position);
 extern void GL_context_blit_s(const GL_Context_t *context, const GL_Surface_t *surface, GL_Rectangle_t area, GL_Point_t position, float sx, float sy);
 extern void GL_context_blit_sr(const GL_Context_t *context, const GL_Surface_t *surface, GL_Rectangle_t area, GL_Point_t position, float sx, float sy, int rotation, float ax, float ay);
 extern void GL_context_blit_x(const GL_Context_t *context, const GL_Surface_t *surface, GL_Point_t position, const GL_XForm_t *xform);
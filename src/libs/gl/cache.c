@@ -0,0 +1,256 @@
+/*
+ * Copyright (c) 2019-2020 by Marco Lizza (marco.lizza@gmail.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+#include "cache.h"
+
+#include <config.h>
+#include <libs/imath.h>
+#include <libs/log.h>
+#include <libs/sincos.h>
+#include <libs/stb.h>
+
+#include "blit.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LOG_CONTEXT "gl-cache"
+
+bool GL_cache_create(GL_Cache_t *cache, size_t budget)
+{
+    *cache = (GL_Cache_t){
+            .budget = budget
+        };
+
+    Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "cache created w/ a budget of %d bytes", budget);
+    return true;
+}
+
+// FNV-1a, keys are short enough.
+static inline size_t hash(const GL_Cache_Key_t *key)
+{
+    const uint8_t *ptr = (const uint8_t *)key;
+    uint32_t value = 2166136261u;
+    for (size_t i = 0; i < sizeof(GL_Cache_Key_t); ++i) {
+        value = (value ^ ptr[i]) * 16777619u;
+    }
+    return (size_t)value;
+}
+
+static inline size_t footprint(const GL_Cache_Entry_t *entry)
+{
+    return sizeof(GL_Cache_Entry_t) + entry->surface.data_size;
+}
+
+static inline void release(GL_Cache_t *cache, GL_Cache_Entry_t *entry)
+{
+    cache->used -= footprint(entry);
+    GL_surface_delete(&entry->surface);
+    free(entry);
+}
+
+void GL_cache_delete(GL_Cache_t *cache)
+{
+    for (size_t i = 0; i < GL_CACHE_BUCKETS; ++i) {
+        GL_Cache_Entry_t **bucket = cache->buckets[i];
+        for (ptrdiff_t j = 0; j < arrlen(bucket); ++j) {
+            release(cache, bucket[j]);
+        }
+        arrfree(bucket);
+        cache->buckets[i] = NULL;
+    }
+
+    Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "cache deleted");
+}
+
+// Pending (deferred) commands could refer to the entries' surfaces, flush them before releasing anything.
+void GL_cache_sanitize(GL_Cache_t *cache, const GL_Context_t *context, const GL_Sheet_t *sheet)
+{
+    GL_context_flush(context);
+
+    for (size_t i = 0; i < GL_CACHE_BUCKETS; ++i) {
+        GL_Cache_Entry_t **bucket = cache->buckets[i];
+        for (ptrdiff_t j = arrlen(bucket) - 1; j >= 0; --j) {
+            if (bucket[j]->key.sheet == sheet) {
+                release(cache, bucket[j]);
+                arrdelswap(bucket, j);
+            }
+        }
+    }
+}
+
+// Evict the least recently used entries until `size` more bytes fit into the budget. The entries are few (and
+// evictions rare) so a linear scan is preferred over maintaining a list.
+static void evict(GL_Cache_t *cache, const GL_Context_t *context, size_t size)
+{
+    if (cache->used + size <= cache->budget) {
+        return;
+    }
+
+    GL_context_flush(context);
+
+    while (cache->used > 0 && cache->used + size > cache->budget) {
+        size_t lru_bucket = 0;
+        ptrdiff_t lru_index = -1;
+        for (size_t i = 0; i < GL_CACHE_BUCKETS; ++i) {
+            GL_Cache_Entry_t **bucket = cache->buckets[i];
+            for (ptrdiff_t j = 0; j < arrlen(bucket); ++j) {
+                if (lru_index < 0 || bucket[j]->tick < cache->buckets[lru_bucket][lru_index]->tick) {
+                    lru_bucket = i;
+                    lru_index = j;
+                }
+            }
+        }
+        release(cache, cache->buckets[lru_bucket][lru_index]);
+        arrdelswap(cache->buckets[lru_bucket], lru_index);
+    }
+}
+
+// Draw the transformed cell with the sheet (default state) on a scratch context large enough to hold it at any
+// rotation, then trim it to the written area. Uncovered pixels are left as index zero, just as the trimmed borders.
+static GL_Cache_Entry_t *render(const GL_Sheet_t *sheet, const GL_Cache_Key_t *key)
+{
+    const float scale_x = (float)key->scale_x / (float)GL_CACHE_STEPS;
+    const float scale_y = (float)key->scale_y / (float)GL_CACHE_STEPS;
+    const float anchor_x = (float)key->anchor_x / (float)GL_CACHE_STEPS;
+    const float anchor_y = (float)key->anchor_y / (float)GL_CACHE_STEPS;
+
+    const float w = (float)sheet->size.width * fabsf(scale_x);
+    const float h = (float)sheet->size.height * fabsf(scale_y);
+    const float ax = w * anchor_x;
+    const float ay = h * anchor_y;
+    const float radius = fmaxf(fmaxf(hypotf(ax, ay), hypotf(w - ax, ay)), fmaxf(hypotf(ax, h - ay), hypotf(w - ax, h - ay)));
+
+    const int margin = (int)ceilf(radius) + 2;
+    const size_t size = (size_t)(margin * 2 + 1);
+
+    GL_Cache_Entry_t *entry = malloc(sizeof(GL_Cache_Entry_t));
+    if (!entry) {
+        return NULL;
+    }
+    *entry = (GL_Cache_Entry_t){
+            .key = *key
+        };
+
+    GL_Context_t scratch;
+    if (!GL_context_create(&scratch, size, size)) {
+        free(entry);
+        return NULL;
+    }
+    GL_context_clear(&scratch);
+    GL_sheet_blit_sr(&scratch, sheet, key->cell_id, (GL_Point_t){ .x = margin, .y = margin }, scale_x, scale_y, key->rotation, anchor_x, anchor_y);
+
+    int x0 = (int)size, y0 = (int)size, x1 = -1, y1 = -1;
+    const GL_Pixel_t *sptr = scratch.buffer.data;
+    for (int y = 0; y < (int)size; ++y) {
+        for (int x = 0; x < (int)size; ++x) {
+            if (sptr[x] == 0) {
+                continue;
+            }
+            x0 = imin(x0, x);
+            x1 = imax(x1, x);
+            y0 = imin(y0, y);
+            y1 = y;
+        }
+        sptr += scratch.buffer.stride;
+    }
+
+    if (x1 >= 0) { // When fully transparent, keep the entry empty to avoid rendering it again.
+        if (!GL_surface_create(&entry->surface, (size_t)(x1 - x0 + 1), (size_t)(y1 - y0 + 1))) {
+            GL_context_delete(&scratch);
+            free(entry);
+            return NULL;
+        }
+        for (int y = y0; y <= y1; ++y) {
+            memcpy(entry->surface.data + (y - y0) * entry->surface.stride, scratch.buffer.data + y * scratch.buffer.stride + x0, entry->surface.width);
+        }
+        entry->offset = (GL_Point_t){ .x = x0 - margin, .y = y0 - margin };
+    }
+
+    GL_context_delete(&scratch);
+
+    return entry;
+}
+
+// The cached surface stores the raw cell indexes, so shifting and transparency are applied when blitting as usual.
+// Uncovered pixels and trimmed borders are index zero, which is why the cache is used only when it is transparent.
+void GL_cache_blit_sr(GL_Cache_t *cache, const GL_Context_t *context, const GL_Sheet_t *sheet, size_t cell_id, GL_Point_t position, float scale_x, float scale_y, int rotation, float anchor_x, float anchor_y)
+{
+    const GL_State_t *state = &context->state;
+    if (!state->transparent[state->shifting[0]]) {
+        GL_sheet_blit_sr(context, sheet, cell_id, position, scale_x, scale_y, rotation, anchor_x, anchor_y);
+        return;
+    }
+
+    GL_Cache_Key_t key;
+    memset(&key, 0, sizeof(GL_Cache_Key_t)); // Keys are hashed and compared byte-wise, padding included.
+    key.sheet = sheet;
+    key.cell_id = cell_id;
+    key.scale_x = (int)lroundf(scale_x * (float)GL_CACHE_STEPS);
+    key.scale_y = (int)lroundf(scale_y * (float)GL_CACHE_STEPS);
+    key.rotation = rotation & (SINCOS_PERIOD - 1);
+    key.anchor_x = (int)lroundf(anchor_x * (float)GL_CACHE_STEPS);
+    key.anchor_y = (int)lroundf(anchor_y * (float)GL_CACHE_STEPS);
+
+    GL_Cache_Entry_t ***bucket = &cache->buckets[hash(&key) % GL_CACHE_BUCKETS];
+
+    GL_Cache_Entry_t *entry = NULL;
+    for (ptrdiff_t i = 0; i < arrlen(*bucket); ++i) {
+        if (memcmp(&(*bucket)[i]->key, &key, sizeof(GL_Cache_Key_t)) == 0) {
+            entry = (*bucket)[i];
+            break;
+        }
+    }
+
+    if (!entry) {
+        entry = render(sheet, &key);
+        if (!entry) {
+            Log_write(LOG_LEVELS_WARNING, LOG_CONTEXT, "can't render cell #%d of sheet %p", cell_id, sheet);
+            GL_sheet_blit_sr(context, sheet, cell_id, position, scale_x, scale_y, rotation, anchor_x, anchor_y);
+            return;
+        }
+
+        const size_t size = footprint(entry);
+        if (size > cache->budget) { // Won't ever fit, draw it directly.
+            GL_surface_delete(&entry->surface);
+            free(entry);
+            GL_sheet_blit_sr(context, sheet, cell_id, position, scale_x, scale_y, rotation, anchor_x, anchor_y);
+            return;
+        }
+
+        evict(cache, context, size);
+
+        arrpush(*bucket, entry);
+        cache->used += size;
+    }
+
+    entry->tick = ++cache->tick;
+
+    const GL_Surface_t *surface = &entry->surface;
+    if (surface->width == 0) {
+        return;
+    }
+    GL_context_blit(context, surface, (GL_Rectangle_t){ .x = 0, .y = 0, .width = surface->width, .height = surface->height },
+        (GL_Point_t){ .x = position.x + entry->offset.x, .y = position.y + entry->offset.y });
+}
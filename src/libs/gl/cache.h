@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2019-2020 by Marco Lizza (marco.lizza@gmail.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+#ifndef __GL_CACHE_H__
+#define __GL_CACHE_H__
+
+#include <stdbool.h>
+
+#include "common.h"
+#include "context.h"
+#include "sheet.h"
+#include "surface.h"
+
+#define GL_CACHE_STEPS      256 // Scales and anchors are quantized to 1/256th of unit.
+#define GL_CACHE_BUCKETS    256
+
+typedef struct _GL_Cache_Key_t {
+    const GL_Sheet_t *sheet;
+    size_t cell_id;
+    int scale_x, scale_y; // Quantized, in `1 / GL_CACHE_STEPS` units.
+    int rotation; // Wrapped into the `[0, SINCOS_PERIOD)` range.
+    int anchor_x, anchor_y; // Quantized, as the scale.
+} GL_Cache_Key_t;
+
+typedef struct _GL_Cache_Entry_t {
+    GL_Cache_Key_t key;
+    GL_Surface_t surface; // Trimmed to the written area, empty if none.
+    GL_Point_t offset; // Position of the surface relative to the drawing position.
+    size_t tick; // Last time the entry has been used.
+} GL_Cache_Entry_t;
+
+// Pre-transformed sheet cells, rendered once and later drawn with a plain blit. When the memory budget is exceeded the
+// least recently used entries are evicted.
+//
+// Entries are allocated apart, since (deferred) queued commands refer to their surfaces.
+typedef struct _GL_Cache_t {
+    GL_Cache_Entry_t **buckets[GL_CACHE_BUCKETS];
+    size_t budget;
+    size_t used;
+    size_t tick;
+} GL_Cache_t;
+
+extern bool GL_cache_create(GL_Cache_t *cache, size_t budget);
+extern void GL_cache_delete(GL_Cache_t *cache);
+extern void GL_cache_sanitize(GL_Cache_t *cache, const GL_Context_t *context, const GL_Sheet_t *sheet);
+
+extern void GL_cache_blit_sr(GL_Cache_t *cache, const GL_Context_t *context, const GL_Sheet_t *sheet, size_t cell_id, GL_Point_t position, float scale_x, float scale_y, int rotation, float anchor_x, float anchor_y);
+
+#endif  /* __GL_CACHE_H__ */
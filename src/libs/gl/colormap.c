@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2019-2020 by Marco Lizza (marco.lizza@gmail.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+#include "colormap.h"
+
+#include <config.h>
+#include <libs/log.h>
+#include <libs/stb.h>
+
+#include <stdlib.h>
+
+#define LOG_CONTEXT "gl-colormap"
+
+void GL_colormap_build(GL_Pixel_t *data, const GL_Palette_t *palette, size_t levels, GL_Color_t target)
+{
+    for (size_t i = 0; i < levels; ++i) {
+        GL_Pixel_t *table = data + i * GL_MAX_PALETTE_COLORS;
+        const float ratio = (float)i / (float)(levels - 1);
+        for (size_t j = 0; j < GL_MAX_PALETTE_COLORS; ++j) {
+            if (j >= palette->count) { // Unused entries are left untouched.
+                table[j] = (GL_Pixel_t)j;
+                continue;
+            }
+            const GL_Color_t *color = &palette->colors[j];
+            const GL_Color_t shade = (GL_Color_t){
+                    .r = (uint8_t)((float)(color->r - target.r) * ratio + (float)target.r),
+                    .g = (uint8_t)((float)(color->g - target.g) * ratio + (float)target.g),
+                    .b = (uint8_t)((float)(color->b - target.b) * ratio + (float)target.b),
+                    .a = 255
+                };
+            table[j] = GL_palette_find_nearest_color(palette, shade);
+        }
+    }
+}
+
+bool GL_colormaps_create(GL_Colormaps_t *colormaps)
+{
+    *colormaps = (GL_Colormaps_t){ 0 };
+
+    Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "colormaps created");
+    return true;
+}
+
+void GL_colormaps_delete(GL_Colormaps_t *colormaps)
+{
+    for (ptrdiff_t i = 0; i < arrlen(colormaps->colormaps); ++i) {
+        GL_Colormap_t *colormap = colormaps->colormaps[i];
+        free(colormap->data);
+        free(colormap);
+    }
+    arrfree(colormaps->colormaps);
+
+    Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "colormaps deleted");
+}
+
+const GL_Colormap_t *GL_colormaps_fetch(GL_Colormaps_t *colormaps, const GL_Palette_t *palette, size_t levels, GL_Color_t target)
+{
+    if (levels < 2) { // At least the target and the original colors.
+        levels = 2;
+    }
+    target.a = 255;
+
+    for (ptrdiff_t i = 0; i < arrlen(colormaps->colormaps); ++i) {
+        const GL_Colormap_t *colormap = colormaps->colormaps[i];
+        if (colormap->levels == levels && GL_palette_pack_color(colormap->target) == GL_palette_pack_color(target)) {
+            return colormap;
+        }
+    }
+
+    GL_Colormap_t *colormap = malloc(sizeof(GL_Colormap_t));
+    if (!colormap) {
+        Log_write(LOG_LEVELS_ERROR, LOG_CONTEXT, "can't allocate colormap");
+        return NULL;
+    }
+    GL_Pixel_t *data = malloc(levels * GL_MAX_PALETTE_COLORS * sizeof(GL_Pixel_t));
+    if (!data) {
+        Log_write(LOG_LEVELS_ERROR, LOG_CONTEXT, "can't allocate colormap data");
+        free(colormap);
+        return NULL;
+    }
+    GL_colormap_build(data, palette, levels, target);
+
+    *colormap = (GL_Colormap_t){ .levels = levels, .target = target, .data = data };
+    arrpush(colormaps->colormaps, colormap);
+    Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "colormap #%d built w/ %d levels", (int)arrlen(colormaps->colormaps) - 1, (int)levels);
+
+    return colormap;
+}
+
+void GL_colormaps_update(GL_Colormaps_t *colormaps, const GL_Palette_t *palette)
+{
+    for (ptrdiff_t i = 0; i < arrlen(colormaps->colormaps); ++i) {
+        GL_Colormap_t *colormap = colormaps->colormaps[i];
+        GL_colormap_build(colormap->data, palette, colormap->levels, colormap->target);
+    }
+    Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "%d colormap(s) rebuilt", (int)arrlen(colormaps->colormaps));
+}
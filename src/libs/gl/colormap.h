@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2019-2020 by Marco Lizza (marco.lizza@gmail.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+#ifndef __GL_COLORMAP_H__
+#define __GL_COLORMAP_H__
+
+#include <stdbool.h>
+
+#include "common.h"
+#include "palette.h"
+
+// A colormap is a set of shading tables, one for each light level, that fade the palette colors toward a target
+// one. The first level maps to the target color, the last one leaves the colors untouched.
+typedef struct _GL_Colormap_t {
+    size_t levels;
+    GL_Color_t target;
+    GL_Pixel_t *data; // `levels` tables of `GL_MAX_PALETTE_COLORS` entries each.
+} GL_Colormap_t;
+
+// Colormaps built so far, for the current palette. They are individually allocated and rebuilt in place when the
+// palette changes, so that the references held by the contexts remain valid.
+typedef struct _GL_Colormaps_t {
+    GL_Colormap_t **colormaps;
+} GL_Colormaps_t;
+
+extern void GL_colormap_build(GL_Pixel_t *data, const GL_Palette_t *palette, size_t levels, GL_Color_t target);
+
+extern bool GL_colormaps_create(GL_Colormaps_t *colormaps);
+extern void GL_colormaps_delete(GL_Colormaps_t *colormaps);
+extern const GL_Colormap_t *GL_colormaps_fetch(GL_Colormaps_t *colormaps, const GL_Palette_t *palette, size_t levels, GL_Color_t target);
+extern void GL_colormaps_update(GL_Colormaps_t *colormaps, const GL_Palette_t *palette);
+
+#endif  /* __GL_COLORMAP_H__ */
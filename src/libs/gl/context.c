@@ -27,32 +27,61 @@
 #include <libs/log.h>
 #include <libs/stb.h>
 
+#include "queue.h"
+#include "simd.h"
 #include "surface.h"
 
+#include <stdlib.h>
+#include <string.h>
+
 #define LOG_CONTEXT "gl"
 
+static inline void update_fingerprint(GL_State_t *state)
+{
+    GL_Fingerprint_t *fingerprint = &state->fingerprint;
+    fingerprint->identity = GL_simd_identity(state->shifting);
+    fingerprint->transparent = GL_simd_keys(state->transparent, fingerprint->keys);
+    fingerprint->masked = state->mask != NULL;
+    fingerprint->blended = state->blending != NULL;
+    fingerprint->shaded = state->shading.colormap != NULL;
+}
+
 static inline void reset_state(GL_State_t *state, GL_Surface_t *surface)
 {
     *state = (GL_State_t){
             .surface = surface,
             .clipping_region = (GL_Quad_t){ .x0 = 0, .y0 = 0, .x1 = surface->width - 1, .y1 = surface->height - 1 },
-            .background = 0,
-#ifdef __STENCIL_SUPPORT__
-            .stencil = NULL,
-            .threshold = 0
-#endif
+            .background = 0
         };
     for (size_t i = 0; i < GL_MAX_PALETTE_COLORS; ++i) {
         state->shifting[i] = i;
         state->transparent[i] = GL_BOOL_FALSE;
     }
     state->transparent[0] = GL_BOOL_TRUE;
+    update_fingerprint(state);
+}
+
+// The default drawing target, that is the selected layer (if any) or the buffer.
+static inline GL_Surface_t *canvas(GL_Context_t *context)
+{
+    return context->layers ? &context->layers[context->layer] : &context->buffer;
+}
+
+static void release_layers(GL_Context_t *context)
+{
+    for (size_t i = 0; i < (size_t)arrlen(context->layers); ++i) {
+        GL_surface_delete(&context->layers[i]);
+    }
+    arrfree(context->layers);
+    context->layer = 0;
 }
 
 bool GL_context_create(GL_Context_t *context, size_t width, size_t height)
 {
     *context = (GL_Context_t){ 0 };
 
+    GL_simd_initialize();
+
     GL_surface_create(&context->buffer, width, height);
 
     reset_state(&context->state, &context->buffer);
@@ -63,9 +92,14 @@ bool GL_context_create(GL_Context_t *context, size_t width, size_t height)
 
 void GL_context_delete(GL_Context_t *context)
 {
+    GL_context_defer(context, false, 0);
+
     arrfree(context->stack);
     Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "context stack deallocated");
 
+    release_layers(context);
+    Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "context layers deallocated");
+
     GL_surface_delete(&context->buffer);
     Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "context buffer deallocated");
 
@@ -91,27 +125,144 @@ void GL_context_reset(GL_Context_t *context)
     arrfree(context->stack);
     Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "context stack deallocated");
 
-    reset_state(&context->state, &context->buffer);
+    reset_state(&context->state, canvas(context));
     Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "context reset");
 }
 
 void GL_context_sanitize(GL_Context_t *context, const GL_Surface_t *surface)
 {
+    GL_context_flush(context); // The surface is about to be released, pending commands could still refer to it.
+
     for (int i = arrlen(context->stack) - 1; i >= 0; --i) {
-#ifdef __GL_MASK_SUPPORT__
-        if (context->stack[i].surface == surface || context->stack[i].mask.stencil == surface) {
-#else
         if (context->stack[i].surface == surface) {
-#endif
             arrdel(context->stack, i);
             Log_write(LOG_LEVELS_WARNING, LOG_CONTEXT, "state #%d sanitized from context", i);
         }
     }
 }
 
+void GL_context_sanitize_mask(GL_Context_t *context, const GL_Mask_t *mask)
+{
+    GL_context_flush(context); // Ditto, for masks.
+
+    for (int i = arrlen(context->stack) - 1; i >= 0; --i) {
+        if (context->stack[i].mask == mask) {
+            arrdel(context->stack, i);
+            Log_write(LOG_LEVELS_WARNING, LOG_CONTEXT, "state #%d sanitized from context", i);
+        }
+    }
+
+    if (context->state.mask == mask) { // Unlike surfaces, the mask can't be replaced with a default one.
+        GL_context_mask(context, NULL, (GL_Point_t){ 0 });
+    }
+}
+
+void GL_context_defer(GL_Context_t *context, bool enabled, size_t workers)
+{
+    if (enabled && !context->queue) {
+        GL_Queue_t *queue = malloc(sizeof(GL_Queue_t));
+        if (!queue || !GL_queue_create(queue, workers)) {
+            Log_write(LOG_LEVELS_ERROR, LOG_CONTEXT, "can't create queue, keeping immediate mode");
+            free(queue);
+            return;
+        }
+        context->queue = queue;
+        Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "context deferred w/ queue %p", queue);
+    } else
+    if (!enabled && context->queue) {
+        GL_context_flush(context);
+        GL_queue_delete(context->queue);
+        free(context->queue);
+        context->queue = NULL;
+        Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "context back to immediate mode");
+    }
+}
+
+void GL_context_flush(const GL_Context_t *context)
+{
+    if (context->queue) {
+        GL_queue_replay(context->queue, context);
+    }
+}
+
+// Layers are created blank (i.e. fully transparent, but for the bottom-most) with the size of the buffer. A single
+// layer would be the buffer itself, so no layers are created in that case. Since the states could be referring to the
+// released layers, the context is reset.
+bool GL_context_layers(GL_Context_t *context, size_t count)
+{
+    GL_context_flush(context);
+
+    release_layers(context);
+
+    for (size_t i = 0; count > 1 && i < count; ++i) {
+        GL_Surface_t layer = { 0 };
+        if (!GL_surface_create(&layer, context->buffer.width, context->buffer.height) || !GL_surface_track(&layer, true)) {
+            Log_write(LOG_LEVELS_ERROR, LOG_CONTEXT, "can't create layer #%d", (int)i);
+            GL_surface_delete(&layer);
+            release_layers(context);
+            GL_context_reset(context);
+            return false;
+        }
+        memset(layer.data, 0, layer.data_size);
+        arrpush(context->layers, layer);
+    }
+    Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "context w/ %d layer(s)", (int)arrlen(context->layers));
+
+    GL_context_reset(context);
+
+    return true;
+}
+
+void GL_context_layer(GL_Context_t *context, size_t index)
+{
+    if (index >= (size_t)arrlen(context->layers)) {
+        Log_write(LOG_LEVELS_WARNING, LOG_CONTEXT, "layer #%d not available", (int)index);
+        return;
+    }
+    context->layer = index;
+    GL_context_surface(context, NULL);
+}
+
+// Composite the layers in z-order into the buffer, the bottom-most being opaque and the others keyed on index `0`.
+// Only the rows that changed on any layer since the last composition are processed.
+void GL_context_compose(const GL_Context_t *context)
+{
+    GL_context_flush(context); // Draw the pending commands, if any.
+
+    const size_t count = arrlen(context->layers);
+    if (count == 0) {
+        return;
+    }
+
+    const GL_Surface_t *buffer = &context->buffer;
+    const GL_Surface_t *layers = context->layers;
+    const size_t width = buffer->width;
+    const size_t stride = buffer->stride; // Layers are created with the same size of the buffer.
+    const GL_Pixel_t keys[1] = { 0 };
+
+    for (size_t y = 0; y < buffer->height; ++y) {
+        GL_Bool_t dirty = GL_BOOL_FALSE;
+        for (size_t i = 0; i < count; ++i) {
+            dirty |= layers[i].dirty[y];
+            layers[i].dirty[y] = GL_BOOL_FALSE;
+        }
+        if (!dirty) {
+            continue;
+        }
+
+        const size_t offset = y * stride;
+        GL_Pixel_t *dptr = buffer->data + offset;
+        memcpy(dptr, layers[0].data + offset, width);
+        for (size_t i = 1; i < count; ++i) {
+            GL_simd_copy(dptr, layers[i].data + offset, width, keys, 1);
+        }
+        GL_surface_touch(buffer, (int)y, (int)y);
+    }
+}
+
 void GL_context_surface(GL_Context_t *context, GL_Surface_t *surface)
 {
-    GL_Surface_t *buffer = !surface ? &context->buffer : surface;
+    GL_Surface_t *buffer = !surface ? canvas(context) : surface;
     if (context->state.surface != buffer) {
         context->state.surface = buffer;
         GL_context_clipping(context, NULL); // Reset the clipping region on surface change.
@@ -130,6 +281,7 @@ void GL_context_shifting(GL_Context_t *context, const size_t *from, const size_t
             state->shifting[from[i]] = to[i];
         }
     }
+    update_fingerprint(state);
 }
 
 void GL_context_transparent(GL_Context_t *context, const GL_Pixel_t *indexes, const GL_Bool_t *transparent, size_t count)
@@ -145,6 +297,7 @@ void GL_context_transparent(GL_Context_t *context, const GL_Pixel_t *indexes, co
             state->transparent[indexes[i]] = transparent[i];
         }
     }
+    update_fingerprint(state);
 }
 
 void GL_context_clipping(GL_Context_t *context, const GL_Rectangle_t *region)
@@ -185,30 +338,56 @@ void GL_context_pattern(GL_Context_t *context, uint32_t pattern)
     state->pattern = pattern;
 }
 
-#ifdef __GL_MASK_SUPPORT__
-void GL_context_mask(GL_Context_t *context, const GL_Mask_t *mask)
+void GL_context_blending(GL_Context_t *context, const GL_Pixel_t *table)
+{
+    GL_State_t *state = &context->state;
+    state->blending = table;
+    update_fingerprint(state);
+}
+
+void GL_context_shading(GL_Context_t *context, const GL_Shading_t *shading)
 {
     GL_State_t *state = &context->state;
-    if (!mask) {
-        state->mask = (GL_Mask_t){ 0 };
+    if (!shading) {
+        state->shading = (GL_Shading_t){ 0 };
     } else {
-        state->mask = *mask;
+        state->shading = *shading;
     }
+    update_fingerprint(state);
+}
+
+void GL_context_mask(GL_Context_t *context, const GL_Mask_t *mask, GL_Point_t position)
+{
+    GL_State_t *state = &context->state;
+    state->mask = mask;
+    state->mask_position = mask ? position : (GL_Point_t){ 0 };
+    update_fingerprint(state);
 }
-#endif
 
 void GL_context_clear(const GL_Context_t *context)
 {
     const GL_State_t *state = &context->state;
-    const GL_Pixel_t color = state->background;
-    GL_Pixel_t *dst = state->surface->data;
-    for (size_t i = state->surface->data_size; i; --i) {
-        *(dst++) = color;
+    if (context->queue) {
+        GL_queue_clear(context->queue, state);
+        return;
     }
+    const GL_Surface_t *surface = state->surface;
+    if (surface->memory) { // The rows padding is cleared too, which is harmless.
+        memset(surface->data, state->background, surface->data_size); // Already vectorized by the C library.
+    } else { // Views must keep the surrounding pixels untouched.
+        GL_Pixel_t *dptr = surface->data;
+        for (size_t i = surface->height; i; --i) {
+            memset(dptr, state->background, surface->width);
+            dptr += surface->stride;
+        }
+    }
+    GL_surface_touch(surface, 0, (int)surface->height - 1);
 }
 
 void GL_context_to_surface(const GL_Context_t *context, const GL_Surface_t *to)
 {
+    GL_context_flush(context);
+
     const GL_State_t *state = &context->state;
     const GL_Surface_t *from = state->surface;
 
@@ -218,8 +397,8 @@ void GL_context_to_surface(const GL_Context_t *context, const GL_Surface_t *to)
     const GL_Pixel_t *src = from->data;
     GL_Pixel_t *dst = to->data;
 
-    const int src_skip = from->width - width;
-    const int dst_skip = to->width - width;
+    const int src_skip = from->stride - width;
+    const int dst_skip = to->stride - width;
 
     for (int i = height; i; --i) {
         for (int j = width; j; --j) {
@@ -228,4 +407,6 @@ void GL_context_to_surface(const GL_Context_t *context, const GL_Surface_t *to)
         src += src_skip;
         dst += dst_skip;
     }
+
+    GL_surface_touch(to, 0, (int)height - 1);
 }
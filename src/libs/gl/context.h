@@ -25,20 +25,35 @@
 
 #include <config.h>
 
+#include "colormap.h"
 #include "common.h"
+#include "mask.h"
 #include "palette.h"
+#include "simd.h"
 #include "surface.h"
 
 #include <stdbool.h>
 
 #define GL_XFORM_TABLE_MAX_OPERATIONS       16
 
-#ifdef __GL_MASK_SUPPORT__
-typedef struct _GL_Mask_t {
-    const GL_Surface_t *stencil;
-    GL_Pixel_t threshold;
-} GL_Mask_t;
-#endif
+// Shading applied by the blits, after shifting and transparency. The light level is a linear function of the
+// (target surface) position, that is `level + x * dx + y * dy`, rounded and clamped to the colormap range. This
+// accounts for per-sprite (no gradient), per-scanline (`dy` only) or per-column (`dx` only) shading.
+typedef struct _GL_Shading_t {
+    const GL_Colormap_t *colormap;
+    float level;
+    float dx, dy;
+} GL_Shading_t;
+
+// Summary of the shifting/transparent/mask state, kept up-to-date by the setters, used to pick specialized kernels.
+typedef struct _GL_Fingerprint_t {
+    bool identity; // The shifting table doesn't change any index.
+    size_t transparent; // Amount of transparent indexes, `GL_SIMD_MAX_KEYS + 1` meaning "many".
+    GL_Pixel_t keys[GL_SIMD_MAX_KEYS]; // The transparent indexes, unless "many".
+    bool masked;
+    bool blended; // A blending table is active, the destination is read back.
+    bool shaded;
+} GL_Fingerprint_t;
 
 typedef struct _GL_State_t {
     GL_Surface_t *surface;
@@ -48,15 +63,22 @@ typedef struct _GL_State_t {
     uint32_t pattern; // TODO: ditto
     GL_Pixel_t shifting[GL_MAX_PALETTE_COLORS];
     GL_Bool_t transparent[GL_MAX_PALETTE_COLORS];
-#ifdef __GL_MASK_SUPPORT__
-    GL_Mask_t mask;
-#endif
+    const GL_Mask_t *mask; // When not `NULL`, blits draw only where the mask bits are set.
+    GL_Point_t mask_position; // Placement of the mask on the target surface.
+    const GL_Pixel_t *blending; // `[source][destination]` table (see `blend.h`), `NULL` to overwrite.
+    GL_Shading_t shading;
+    GL_Fingerprint_t fingerprint;
 } GL_State_t;
 
+struct _GL_Queue_t;
+
 typedef struct _GL_Context_t {
     GL_Surface_t buffer;
+    GL_Surface_t *layers; // Retained surfaces composited into the buffer, `NULL` when drawing directly on it.
+    size_t layer; // The one selected as drawing (default) target.
     GL_State_t state;
     GL_State_t *stack;
+    struct _GL_Queue_t *queue; // When not `NULL`, drawing operations are recorded and replayed by `GL_context_flush()`.
 } GL_Context_t;
 
 extern bool GL_context_create(GL_Context_t *context, size_t width, size_t height);
@@ -66,6 +88,12 @@ extern void GL_context_push(GL_Context_t *context);
 extern void GL_context_pop(GL_Context_t *context);
 extern void GL_context_reset(GL_Context_t *context);
 extern void GL_context_sanitize(GL_Context_t *context, const GL_Surface_t *surface);
+extern void GL_context_sanitize_mask(GL_Context_t *context, const GL_Mask_t *mask);
+extern void GL_context_defer(GL_Context_t *context, bool enabled, size_t workers);
+extern void GL_context_flush(const GL_Context_t *context);
+extern bool GL_context_layers(GL_Context_t *context, size_t count);
+extern void GL_context_layer(GL_Context_t *context, size_t index);
+extern void GL_context_compose(const GL_Context_t *context);
 
 extern void GL_context_surface(GL_Context_t *context, GL_Surface_t *surface);
 extern void GL_context_shifting(GL_Context_t *context, const size_t *from, const size_t *to, size_t count);
@@ -74,9 +102,9 @@ extern void GL_context_clipping(GL_Context_t *context, const GL_Rectangle_t *reg
 extern void GL_context_background(GL_Context_t *context, GL_Pixel_t index);
 extern void GL_context_color(GL_Context_t *context, GL_Pixel_t index);
 extern void GL_context_pattern(GL_Context_t *context, uint32_t pattern);
-#ifdef __GL_MASK_SUPPORT__
-extern void GL_context_mask(GL_Context_t *context, const GL_Mask_t *mask);
-#endif
+extern void GL_context_blending(GL_Context_t *context, const GL_Pixel_t *table);
+extern void GL_context_shading(GL_Context_t *context, const GL_Shading_t *shading);
+extern void GL_context_mask(GL_Context_t *context, const GL_Mask_t *mask, GL_Point_t position);
 
 extern void GL_context_clear(const GL_Context_t *context);
 extern void GL_context_to_surface(const GL_Context_t *context, const GL_Surface_t *to);
@@ -23,12 +23,19 @@
 #ifndef __GL_H__
 #define __GL_H__
 
+#include "atlas.h"
+#include "blend.h"
 #include "blit.h"
+#include "cache.h"
+#include "colormap.h"
 #include "common.h"
 #include "context.h"
+#include "mask.h"
 #include "palette.h"
 #include "primitive.h"
+#include "queue.h"
 #include "sheet.h"
+#include "simd.h"
 #include "surface.h"
 
 #endif  /* __GL_H__ */
\ No newline at end of file
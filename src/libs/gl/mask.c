@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2019-2020 by Marco Lizza (marco.lizza@gmail.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+#include "mask.h"
+
+#include <config.h>
+#include <libs/imath.h>
+#include <libs/log.h>
+
+#include <stdlib.h>
+
+#define LOG_CONTEXT "gl-mask"
+
+bool GL_mask_create(GL_Mask_t *mask, size_t width, size_t height)
+{
+    const size_t stride = (width + GL_MASK_WORD_BITS - 1) / GL_MASK_WORD_BITS;
+    GL_Mask_Word_t *data = calloc(stride * height, sizeof(GL_Mask_Word_t)); // All pixels are masked out at first.
+    if (!data) {
+        Log_write(LOG_LEVELS_ERROR, LOG_CONTEXT, "can't allocate %dx%d mask", width, height);
+        return false;
+    }
+
+    *mask = (GL_Mask_t){
+            .width = width,
+            .height = height,
+            .stride = stride,
+            .data = data,
+            .data_size = stride * height
+        };
+
+    Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "mask created at %p (%dx%d, %d bytes)", data, width, height, stride * height * sizeof(GL_Mask_Word_t));
+    return true;
+}
+
+void GL_mask_delete(GL_Mask_t *mask)
+{
+    free(mask->data);
+    Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "mask at %p deleted", mask->data);
+
+    *mask = (GL_Mask_t){ 0 };
+}
+
+// Pixels with an index greater or equal than the threshold are drawable. The mask and the surface are expected to
+// have the same size.
+void GL_mask_threshold(GL_Mask_t *mask, const GL_Surface_t *surface, GL_Pixel_t threshold)
+{
+    const GL_Pixel_t *sptr = surface->data;
+    GL_Mask_Word_t *mptr = mask->data;
+
+    const size_t width = mask->width;
+
+    for (size_t i = mask->height; i; --i) {
+        for (size_t x = 0; x < width; x += GL_MASK_WORD_BITS) {
+            const size_t count = width - x < GL_MASK_WORD_BITS ? width - x : GL_MASK_WORD_BITS;
+            GL_Mask_Word_t word = 0;
+            for (size_t j = 0; j < count; ++j) {
+                word |= (GL_Mask_Word_t)(sptr[j] >= threshold) << j;
+            }
+            *(mptr++) = word;
+            sptr += count;
+        }
+        sptr += surface->stride - width;
+    }
+}
+
+// Pixels of the surface area whose index isn't transparent are set, e.g. to build a collision mask of a sheet cell. The
+// mask is expected to have the same size of the area.
+void GL_mask_opaque(GL_Mask_t *mask, const GL_Surface_t *surface, GL_Rectangle_t area, const GL_Bool_t *transparent)
+{
+    const GL_Pixel_t *sptr = surface->data + area.y * surface->stride + area.x;
+    GL_Mask_Word_t *mptr = mask->data;
+
+    const size_t width = mask->width;
+    const size_t skip = surface->stride - width;
+
+    for (size_t i = mask->height; i; --i) {
+        for (size_t x = 0; x < width; x += GL_MASK_WORD_BITS) {
+            const size_t count = width - x < GL_MASK_WORD_BITS ? width - x : GL_MASK_WORD_BITS;
+            GL_Mask_Word_t word = 0;
+            for (size_t j = 0; j < count; ++j) {
+                word |= (GL_Mask_Word_t)(!transparent[sptr[j]]) << j;
+            }
+            *(mptr++) = word;
+            sptr += count;
+        }
+        sptr += skip;
+    }
+}
+
+// Fetch the 64 bits of the row starting at the (arbitrary) `offset` bit, the ones past the row end being clear.
+static inline GL_Mask_Word_t fetch(const GL_Mask_Word_t *row, size_t stride, size_t offset)
+{
+    const size_t index = offset / GL_MASK_WORD_BITS;
+    const size_t shift = offset % GL_MASK_WORD_BITS;
+    GL_Mask_Word_t word = row[index] >> shift;
+    if (shift && index + 1 < stride) {
+        word |= row[index + 1] << (GL_MASK_WORD_BITS - shift);
+    }
+    return word;
+}
+
+// Tells whether the two masks, placed at the given positions, have at least a set pixel in common. Only the rows (and
+// columns) of the intersection are visited, comparing 64 pixels at once.
+bool GL_mask_overlap(const GL_Mask_t *a, GL_Point_t position_a, const GL_Mask_t *b, GL_Point_t position_b)
+{
+    const int x0 = imax(position_a.x, position_b.x);
+    const int y0 = imax(position_a.y, position_b.y);
+    const int x1 = imin(position_a.x + (int)a->width, position_b.x + (int)b->width);
+    const int y1 = imin(position_a.y + (int)a->height, position_b.y + (int)b->height);
+    if (x0 >= x1 || y0 >= y1) {
+        return false;
+    }
+
+    const size_t width = (size_t)(x1 - x0);
+    const size_t offset_a = (size_t)(x0 - position_a.x);
+    const size_t offset_b = (size_t)(x0 - position_b.x);
+
+    const GL_Mask_Word_t *row_a = a->data + (size_t)(y0 - position_a.y) * a->stride;
+    const GL_Mask_Word_t *row_b = b->data + (size_t)(y0 - position_b.y) * b->stride;
+
+    for (int y = y0; y < y1; ++y) {
+        for (size_t x = 0; x < width; x += GL_MASK_WORD_BITS) {
+            const size_t count = width - x;
+            const GL_Mask_Word_t bits = count < GL_MASK_WORD_BITS ? ((GL_Mask_Word_t)1 << count) - 1 : ~(GL_Mask_Word_t)0;
+            if (fetch(row_a, a->stride, offset_a + x) & fetch(row_b, b->stride, offset_b + x) & bits) {
+                return true;
+            }
+        }
+        row_a += a->stride;
+        row_b += b->stride;
+    }
+    return false;
+}
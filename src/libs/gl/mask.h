@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2019-2020 by Marco Lizza (marco.lizza@gmail.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+#ifndef __GL_MASK_H__
+#define __GL_MASK_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "common.h"
+#include "surface.h"
+
+#define GL_MASK_WORD_BITS   64
+
+typedef uint64_t GL_Mask_Word_t;
+
+// Bit-packed (1 bit per pixel) mask, row-aligned to words. Pixel `x` of a row is bit `x % 64` of its `x / 64`-th
+// word, the padding bits past the mask width are always clear.
+typedef struct _GL_Mask_t {
+    size_t width, height;
+    size_t stride; // In words.
+    GL_Mask_Word_t *data;
+    size_t data_size;
+} GL_Mask_t;
+
+extern bool GL_mask_create(GL_Mask_t *mask, size_t width, size_t height);
+extern void GL_mask_delete(GL_Mask_t *mask);
+extern void GL_mask_threshold(GL_Mask_t *mask, const GL_Surface_t *surface, GL_Pixel_t threshold);
+extern void GL_mask_opaque(GL_Mask_t *mask, const GL_Surface_t *surface, GL_Rectangle_t area, const GL_Bool_t *transparent);
+extern bool GL_mask_overlap(const GL_Mask_t *a, GL_Point_t position_a, const GL_Mask_t *b, GL_Point_t position_b);
+
+#endif  /* __GL_MASK_H__ */
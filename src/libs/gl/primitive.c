@@ -23,11 +23,13 @@
 #include "primitive.h"
 
 #include <config.h>
+#include <libs/fixed.h>
 #include <libs/imath.h>
 #include <libs/gl/gl.h>
 #include <libs/stb.h>
 
 #include <math.h>
+#include <string.h>
 
 #define REGION_INSIDE   0
 #define REGION_LEFT     1
@@ -35,7 +37,39 @@
 #define REGION_RIGHT    4
 #define REGION_BELOW    8
 
-static void point(const GL_Surface_t *surface, const GL_Quad_t *clipping_region, int x, int y, GL_Pixel_t index)
+#define TRIANGLE_TILE_SIZE  8
+
+#define TILE_OUTSIDE    -1
+#define TILE_PARTIAL    0
+#define TILE_INSIDE     1
+
+// When a blending table is active the destination is read back, so the primitives take care to draw each pixel once.
+static inline void plot(GL_Pixel_t *dptr, GL_Pixel_t index, const GL_Pixel_t *blending)
+{
+    *dptr = blending ? blending[index * GL_MAX_PALETTE_COLORS + *dptr] : index;
+}
+
+static inline void span(GL_Pixel_t *dptr, int count, GL_Pixel_t index, const GL_Pixel_t *blending)
+{
+    if (!blending) {
+        memset(dptr, index, (size_t)count); // Already vectorized by the C library.
+        return;
+    }
+    const GL_Pixel_t *row = blending + index * GL_MAX_PALETTE_COLORS;
+    for (int i = count; i; --i) {
+        *dptr = row[*dptr];
+        ++dptr;
+    }
+}
+
+// Mark the rows of the `[y0, y1]` range (clipped) as changed, for the primitives that don't compute a drawing region.
+static inline void touch(const GL_State_t *state, int y0, int y1)
+{
+    const GL_Quad_t *clipping_region = &state->clipping_region;
+    GL_surface_touch(state->surface, imax(y0, clipping_region->y0), imin(y1, clipping_region->y1));
+}
+
+static void point(const GL_Surface_t *surface, const GL_Quad_t *clipping_region, int x, int y, GL_Pixel_t index, const GL_Pixel_t *blending)
 {
     if (x < clipping_region->x0) {
         return;
@@ -50,7 +84,22 @@ static void point(const GL_Surface_t *surface, const GL_Quad_t *clipping_region,
         return;
     }
 
-    surface->data[y * surface->width + x] = index;
+    plot(surface->data + y * surface->stride + x, index, blending);
+}
+
+// Classify a `width` by `height` tile against a single edge function, given its value `e` at the top-left corner.
+static inline int classify_tile(int e, int dx, int dy, int width, int height)
+{
+    const int e_tr = e - dy * (width - 1);
+    const int e_bl = e + dx * (height - 1);
+    const int e_br = e_bl - dy * (width - 1);
+    if ((e & e_tr & e_bl & e_br) < 0) { // All the corners are negative.
+        return TILE_OUTSIDE;
+    } else
+    if ((e | e_tr | e_bl | e_br) >= 0) { // None of the corners is negative.
+        return TILE_INSIDE;
+    }
+    return TILE_PARTIAL;
 }
 
 // https://sighack.com/post/cohen-sutherland-line-clipping-algorithm
@@ -72,12 +121,17 @@ static inline int compute_code(const GL_Quad_t *clipping_region, int x, int y)
     return code;
 }
 
-// DDA algorithm, no branches in the inner-loop.
-static void line(const GL_Surface_t *surface, const GL_Quad_t *clipping_region, int x0, int y0, int x1, int y1, GL_Pixel_t index)
+// DDA algorithm, no branches in the inner-loop. When `skip_first` is set the starting pixel is not drawn (unless it has
+// been moved by the clipping), so that the segments of a polyline don't overlap on the shared vertices.
+static void line(const GL_Surface_t *surface, const GL_Quad_t *clipping_region, int x0, int y0, int x1, int y1, GL_Pixel_t index, const GL_Pixel_t *blending, bool skip_first)
 {
     int code0 = compute_code(clipping_region, x0, y0);
     int code1 = compute_code(clipping_region, x1, y1);
 
+    if (code0) {
+        skip_first = false;
+    }
+
     for (;;) {
         if (!(code0 | code1)) { // bitwise OR is 0: both points inside window; trivially accept and exit loop
             break;
@@ -135,7 +189,7 @@ static void line(const GL_Surface_t *surface, const GL_Quad_t *clipping_region,
 #ifdef __DDA__
     GL_Pixel_t *ddata = surface->data;
 
-    const int dwidth = surface->width;
+    const int dstride = surface->stride;
 
     const int dx = x1 - x0;
     const int dy = y1 - y0;
@@ -148,30 +202,39 @@ static void line(const GL_Surface_t *surface, const GL_Quad_t *clipping_region,
     float x = x0 + 0.5f;
     float y = y0 + 0.5f;
     for (int i = delta + 1; i; --i) { // One more step, to reach and ending pixel.
-        GL_Pixel_t *dptr = ddata + (int)y * dwidth + (int)x;
-        *dptr = index;
+        GL_Pixel_t *dptr = ddata + (int)y * dstride + (int)x;
+        if (!skip_first || i <= delta) {
+            plot(dptr, index, blending);
+        }
 
         x += xin;
         y += yin;
     }
 #else
-    const int dwidth = surface->width;
+    const int dstride = surface->stride;
 
     const int dx = iabs(x1 - x0);
     const int dy = -iabs(y1 - y0);
 
     const int sx = x0 < x1 ? 1 : -1;
-    const int sy = y0 < y1 ? dwidth : -dwidth;
+    const int sy = y0 < y1 ? dstride : -dstride;
 
     int err = dx + dy;
 
     GL_Pixel_t *ddata = surface->data;
 
-    GL_Pixel_t *dptr = ddata + y0 * dwidth + x0;
-    GL_Pixel_t *eod = ddata + y1 * dwidth + x1;
+    GL_Pixel_t *dptr = ddata + y0 * dstride + x0;
+    GL_Pixel_t *eod = ddata + y1 * dstride + x1;
+
+    if (skip_first && dptr == eod) { // Single pixel line, already drawn.
+        return;
+    }
 
     for (;;) {
-        *dptr = index;
+        if (!skip_first) {
+            plot(dptr, index, blending);
+        }
+        skip_first = false;
         if (dptr == eod) {
             break;
         }
@@ -188,7 +251,7 @@ static void line(const GL_Surface_t *surface, const GL_Quad_t *clipping_region,
 #endif
 }
 
-static void hline(const GL_Surface_t *surface, const GL_Quad_t *clipping_region, int x, int y, int length, GL_Pixel_t index)
+static void hline(const GL_Surface_t *surface, const GL_Quad_t *clipping_region, int x, int y, int length, GL_Pixel_t index, const GL_Pixel_t *blending)
 {
     GL_Quad_t drawing_region = (GL_Quad_t){
             .x0 = x,
@@ -218,16 +281,14 @@ static void hline(const GL_Surface_t *surface, const GL_Quad_t *clipping_region,
 
     GL_Pixel_t *ddata = surface->data;
 
-    const int dwidth = surface->width;
+    const int dstride = surface->stride;
 
-    GL_Pixel_t *dptr = ddata + drawing_region.y0 * dwidth + drawing_region.x0;
+    GL_Pixel_t *dptr = ddata + drawing_region.y0 * dstride + drawing_region.x0;
 
-    for (int i = width; i; --i) {
-        *(dptr++) = index;
-    }
+    span(dptr, width, index, blending);
 }
 
-static void vline(const GL_Surface_t *surface, const GL_Quad_t *clipping_region, int x, int y, int length, GL_Pixel_t index)
+static void vline(const GL_Surface_t *surface, const GL_Quad_t *clipping_region, int x, int y, int length, GL_Pixel_t index, const GL_Pixel_t *blending)
 {
     GL_Quad_t drawing_region = (GL_Quad_t){
             .x0 = x,
@@ -257,20 +318,25 @@ static void vline(const GL_Surface_t *surface, const GL_Quad_t *clipping_region,
 
     GL_Pixel_t *ddata = surface->data;
 
-    const int dwidth = surface->width;
+    const int dstride = surface->stride;
 
-    GL_Pixel_t *dptr = ddata + drawing_region.y0 * dwidth + drawing_region.x0;
+    GL_Pixel_t *dptr = ddata + drawing_region.y0 * dstride + drawing_region.x0;
 
-    const int dskip = dwidth;
+    const int dskip = dstride;
 
     for (int i = height; i; --i) {
-        *dptr = index;
+        plot(dptr, index, blending);
         dptr += dskip;
     }
 }
 
 void GL_primitive_point(const GL_Context_t *context, GL_Point_t position, GL_Pixel_t index)
 {
+    if (context->queue) {
+        GL_queue_point(context->queue, &context->state, position, index);
+        return;
+    }
+
     const GL_State_t *state = &context->state;
     const GL_Quad_t *clipping_region = &state->clipping_region;
     const GL_Pixel_t *shifting = state->shifting;
@@ -283,11 +349,18 @@ void GL_primitive_point(const GL_Context_t *context, GL_Point_t position, GL_Pix
         return;
     }
 
-    point(surface, clipping_region, position.x, position.y, index);
+    touch(state, position.y, position.y);
+
+    point(surface, clipping_region, position.x, position.y, index, state->blending);
 }
 
 void GL_primitive_hline(const GL_Context_t *context, GL_Point_t origin, size_t w, GL_Pixel_t index)
 {
+    if (context->queue) {
+        GL_queue_hline(context->queue, &context->state, origin, w, index);
+        return;
+    }
+
     const GL_State_t *state = &context->state;
     const GL_Quad_t *clipping_region = &state->clipping_region;
     const GL_Pixel_t *shifting = state->shifting;
@@ -300,11 +373,18 @@ void GL_primitive_hline(const GL_Context_t *context, GL_Point_t origin, size_t w
         return;
     }
 
-    hline(surface, clipping_region, origin.x, origin.y, w, index);
+    touch(state, origin.y, origin.y);
+
+    hline(surface, clipping_region, origin.x, origin.y, w, index, state->blending);
 }
 
 void GL_primitive_vline(const GL_Context_t *context, GL_Point_t origin, size_t h, GL_Pixel_t index)
 {
+    if (context->queue) {
+        GL_queue_vline(context->queue, &context->state, origin, h, index);
+        return;
+    }
+
     const GL_State_t *state = &context->state;
     const GL_Quad_t *clipping_region = &state->clipping_region;
     const GL_Pixel_t *shifting = state->shifting;
@@ -317,11 +397,18 @@ void GL_primitive_vline(const GL_Context_t *context, GL_Point_t origin, size_t h
         return;
     }
 
-    vline(surface, clipping_region, origin.x, origin.y, h, index);
+    touch(state, origin.y, origin.y + (int)h - 1);
+
+    vline(surface, clipping_region, origin.x, origin.y, h, index, state->blending);
 }
 
 void GL_primitive_polyline(const GL_Context_t *context, const GL_Point_t *vertices, size_t count, GL_Pixel_t index)
 {
+    if (context->queue) {
+        GL_queue_polyline(context->queue, &context->state, vertices, count, index);
+        return;
+    }
+
     const GL_State_t *state = &context->state;
     const GL_Quad_t *clipping_region = &state->clipping_region;
     const GL_Pixel_t *shifting = state->shifting;
@@ -338,22 +425,40 @@ void GL_primitive_polyline(const GL_Context_t *context, const GL_Point_t *vertic
         return;
     }
 
+    int y0 = vertices[0].y, y1 = vertices[0].y;
+    for (size_t i = 1; i < count; ++i) {
+        y0 = imin(y0, vertices[i].y);
+        y1 = imax(y1, vertices[i].y);
+    }
+    touch(state, y0, y1);
+
+    // Shared vertices are drawn once, including the first one when the polyline is closed.
+    const GL_Point_t *last = vertices + count - 1;
+    bool skip_first = count > 2 && last->x == vertices->x && last->y == vertices->y;
+
     const GL_Point_t *from = vertices;
     for (size_t i = 1; i < count; ++i) {
         const GL_Point_t *to = vertices + i;
-        line(surface, clipping_region, from->x, from->y, to->x, to->y, index);
+        line(surface, clipping_region, from->x, from->y, to->x, to->y, index, state->blending, skip_first);
         from = to;
+        skip_first = true;
     }
 }
 
 void GL_context_process(const GL_Context_t *context, GL_Rectangle_t rectangle)
 {
+    GL_context_flush(context); // Reads back the surface, pending commands need to be drawn.
+
     const GL_State_t *state = &context->state;
     const GL_Quad_t *clipping_region = &state->clipping_region;
     const GL_Pixel_t *shifting = state->shifting;
     const GL_Bool_t *transparent = state->transparent;
     const GL_Surface_t *surface = state->surface;
 
+    if (state->fingerprint.identity) { // Identity shifting leaves the pixels untouched, bail out.
+        return;
+    }
+
     GL_Quad_t drawing_region = (GL_Quad_t){
             .x0 = rectangle.x,
             .y0 = rectangle.y,
@@ -380,13 +485,15 @@ void GL_context_process(const GL_Context_t *context, GL_Rectangle_t rectangle)
         return;
     }
 
+    GL_surface_touch(state->surface, drawing_region.y0, drawing_region.y1);
+
     GL_Pixel_t *sddata = surface->data;
 
-    const int sdwidth = surface->width;
+    const int sdstride = surface->stride;
 
-    GL_Pixel_t *sdptr = sddata + drawing_region.y0 * sdwidth + drawing_region.x0;
+    GL_Pixel_t *sdptr = sddata + drawing_region.y0 * sdstride + drawing_region.x0;
 
-    const int sdskip = sdwidth - width;
+    const int sdskip = sdstride - width;
 
     for (int i = height; i; --i) {
         for (int j = width; j; --j) {
@@ -403,6 +510,11 @@ void GL_context_process(const GL_Context_t *context, GL_Rectangle_t rectangle)
 
 void GL_primitive_filled_rectangle(const GL_Context_t *context, GL_Rectangle_t rectangle, GL_Pixel_t index)
 {
+    if (context->queue) {
+        GL_queue_filled_rectangle(context->queue, &context->state, rectangle, index);
+        return;
+    }
+
     const GL_State_t *state = &context->state;
     const GL_Quad_t *clipping_region = &state->clipping_region;
     const GL_Pixel_t *shifting = state->shifting;
@@ -441,19 +553,19 @@ void GL_primitive_filled_rectangle(const GL_Context_t *context, GL_Rectangle_t r
         return;
     }
 
+    GL_surface_touch(state->surface, drawing_region.y0, drawing_region.y1);
+
     GL_Pixel_t *ddata = surface->data;
 
-    const int dwidth = surface->width;
+    const int dstride = surface->stride;
 
-    GL_Pixel_t *dptr = ddata + drawing_region.y0 * dwidth + drawing_region.x0;
+    GL_Pixel_t *dptr = ddata + drawing_region.y0 * dstride + drawing_region.x0;
 
-    const int dskip = dwidth - width;
+    const GL_Pixel_t *blending = state->blending;
 
     for (int i = height; i; --i) {
-        for (int j = width; j; --j) {
-            *(dptr++) = index;
-        }
-        dptr += dskip;
+        span(dptr, width, index, blending);
+        dptr += dstride;
     }
 }
 
@@ -463,6 +575,11 @@ void GL_primitive_filled_rectangle(const GL_Context_t *context, GL_Rectangle_t r
 // https://github.com/dpethes/2D-rasterizer/blob/master/rasterizer2d.pas
 void GL_primitive_filled_triangle(const GL_Context_t *context, GL_Point_t a, GL_Point_t b, GL_Point_t c, GL_Pixel_t index)
 {
+    if (context->queue) {
+        GL_queue_filled_triangle(context->queue, &context->state, a, b, c, index);
+        return;
+    }
+
     const GL_State_t *state = &context->state;
     const GL_Quad_t *clipping_region = &state->clipping_region;
     const GL_Pixel_t *shifting = state->shifting;
@@ -501,6 +618,8 @@ void GL_primitive_filled_triangle(const GL_Context_t *context, GL_Point_t a, GL_
         return;
     }
 
+    GL_surface_touch(state->surface, drawing_region.y0, drawing_region.y1);
+
     if ((b.x - a.x) * (c.y - a.y) > (c.x - a.x) * (b.y - a.y)) { // Ensure CCW winding.
         GL_Point_t t = a;
         a = b;
@@ -522,49 +641,97 @@ void GL_primitive_filled_triangle(const GL_Context_t *context, GL_Point_t a, GL_
     if ((DY23 < 0) || ((DY23 == 0) && (DX23 > 0))) { C2 += 1; }
     if ((DY31 < 0) || ((DY31 == 0) && (DX31 > 0))) { C3 += 1; }
 
+    // The three edge functions always sum up to the same constant (twice the area plus the fill-rule biases). When
+    // it's not positive no pixel can lie on the inner side of all the edges, so there's nothing to draw.
+    if (C1 + C2 + C3 <= 0) {
+        return;
+    }
+
+    GL_Pixel_t *ddata = surface->data;
+
+    const int dstride = surface->stride;
+
     int CY1 = C1 + DX12 * drawing_region.y0 - DY12 * drawing_region.x0;
     int CY2 = C2 + DX23 * drawing_region.y0 - DY23 * drawing_region.x0;
     int CY3 = C3 + DX31 * drawing_region.y0 - DY31 * drawing_region.x0;
 
-    GL_Pixel_t *ddata = surface->data;
+    GL_Pixel_t *drow = ddata + drawing_region.y0 * dstride + drawing_region.x0;
 
-    const int dwidth = surface->width;
+    const GL_Pixel_t *blending = state->blending;
 
-    GL_Pixel_t *dptr = ddata + drawing_region.y0 * dwidth + drawing_region.x0;
+    // Walk the bounding box in tiles, classifying each of them by the edge values at its four corners. Since the
+    // edge functions are linear, the corners bound the values of the whole tile: fully covered tiles are filled
+    // row-by-row without any further test, tiles lying outside any of the edges are skipped, and only the tiles
+    // crossed by an edge are scanned pixel-by-pixel.
+    for (int ty = 0; ty < height; ty += TRIANGLE_TILE_SIZE) {
+        const int th = imin(TRIANGLE_TILE_SIZE, height - ty);
 
-    const int dskip = dwidth;
+        for (int tx = 0; tx < width; tx += TRIANGLE_TILE_SIZE) {
+            const int tw = imin(TRIANGLE_TILE_SIZE, width - tx);
 
-    for (int y = 0; y <= height; ++y) { // Pinada's edge function is linear, we can cast it...
-        int CX1 = CY1;
-        int CX2 = CY2;
-        int CX3 = CY3;
-        int count = 0;
-        int eod = 0;
-        for (int x = 0; x <= width; ++x) {
-            if ((CX1 | CX2 | CX3) > 0) { // Check the sign bit only.
-                count += 1;
-                eod = x;
+            const int E1 = CY1 - DY12 * tx;
+            const int E2 = CY2 - DY23 * tx;
+            const int E3 = CY3 - DY31 * tx;
+
+            const int c1 = classify_tile(E1, DX12, DY12, tw, th);
+            const int c2 = classify_tile(E2, DX23, DY23, tw, th);
+            const int c3 = classify_tile(E3, DX31, DY31, tw, th);
+
+            if ((c1 == TILE_OUTSIDE) || (c2 == TILE_OUTSIDE) || (c3 == TILE_OUTSIDE)) {
+                continue;
+            }
+
+            GL_Pixel_t *dptr = drow + tx;
+
+            if ((c1 == TILE_INSIDE) && (c2 == TILE_INSIDE) && (c3 == TILE_INSIDE)) {
+                for (int y = 0; y < th; ++y) {
+                    span(dptr, tw, index, blending);
+                    dptr += dstride;
+                }
+                continue;
+            }
+
+            int CX1 = E1;
+            int CX2 = E2;
+            int CX3 = E3;
+            for (int y = 0; y < th; ++y) {
+                int EX1 = CX1;
+                int EX2 = CX2;
+                int EX3 = CX3;
+                for (int x = 0; x < tw; ++x) {
+                    if ((EX1 | EX2 | EX3) >= 0) { // Check the sign bit only.
+                        plot(dptr + x, index, blending);
+                    }
+                    EX1 -= DY12;
+                    EX2 -= DY23;
+                    EX3 -= DY31;
+                }
+                CX1 += DX12;
+                CX2 += DX23;
+                CX3 += DX31;
+                dptr += dstride;
             }
-            CX1 -= DY12;
-            CX2 -= DY23;
-            CX3 -= DY31;
-        }
-        CY1 += DX12;
-        CY2 += DX23;
-        CY3 += DX31;
-
-        const int offset = eod - count;
-        dptr += eod;
-        for (int i = count; i; --i) { // Backward copy, simpler math.
-            *(dptr--) = index;
         }
-        dptr += dskip - offset;
+
+        CY1 += DX12 * th;
+        CY2 += DX23 * th;
+        CY3 += DX31 * th;
+        drow += dstride * th;
     }
 }
 
 // https://www.javatpoint.com/computer-graphics-bresenhams-circle-algorithm
+//
+// Each row is drawn exactly once. The rows closer to the center (at `cy ± x`) are drawn as `x` advances, while the
+// outer ones (at `cy ± y`) are drawn when `y` is about to decrease, being that their widest span. Rows already
+// covered by the inner ones (the octants meet at `x_last`) are skipped.
 void GL_primitive_filled_circle(const GL_Context_t *context, GL_Point_t center, int radius, GL_Pixel_t index)
 {
+    if (context->queue) {
+        GL_queue_filled_circle(context->queue, &context->state, center, radius, index);
+        return;
+    }
+
     const GL_State_t *state = &context->state;
     const GL_Quad_t *clipping_region = &state->clipping_region;
     const GL_Pixel_t *shifting = state->shifting;
@@ -580,22 +747,44 @@ void GL_primitive_filled_circle(const GL_Context_t *context, GL_Point_t center,
     const int cx = center.x;
     const int cy = center.y;
 
+    touch(state, cy - radius, cy + radius);
+
+    const GL_Pixel_t *blending = state->blending;
+
     int x = 0;
     int y = radius;
     int d = 3 - 2 * radius;
 
+    for (; x <= y; ++x) { // Dry run, to find where the octants meet.
+        if (d < 0) {
+            d += 4 * x + 6;
+        } else {
+            d += 4 * (x - y) + 10;
+            y -= 1;
+        }
+    }
+    const int x_last = x - 1;
+
+    x = 0;
+    y = radius;
+    d = 3 - 2 * radius;
+
     while (x <= y) {
-        const int length_x = iabs(2 * x) + 1;
-        const int length_y = iabs(2 * y) + 1;
-        hline(surface, clipping_region, cx - x, cy - y, length_x, index);
-        hline(surface, clipping_region, cx - y, cy - x, length_y, index);
-        hline(surface, clipping_region, cx - y, cy + x, length_y, index);
-        hline(surface, clipping_region, cx - x, cy + y, length_x, index);
+        const int length_y = 2 * y + 1;
+        hline(surface, clipping_region, cx - y, cy - x, length_y, index, blending);
+        if (x != 0) {
+            hline(surface, clipping_region, cx - y, cy + x, length_y, index, blending);
+        }
 
         if (d < 0) {
             d += 4 * x + 6;
             x += 1;
         } else {
+            if (y > x_last) {
+                const int length_x = 2 * x + 1;
+                hline(surface, clipping_region, cx - x, cy - y, length_x, index, blending);
+                hline(surface, clipping_region, cx - x, cy + y, length_x, index, blending);
+            }
             d += 4 * (x - y) + 10;
             x += 1;
             y -= 1;
@@ -603,8 +792,28 @@ void GL_primitive_filled_circle(const GL_Context_t *context, GL_Point_t center,
     }
 }
 
+// Draw the point and its mirrored counterparts, skipping the ones lying on the axes (which would coincide).
+static inline void quadrants(const GL_Surface_t *surface, const GL_Quad_t *clipping_region, int cx, int cy, int x, int y, GL_Pixel_t index, const GL_Pixel_t *blending)
+{
+    point(surface, clipping_region, cx + x, cy + y, index, blending);
+    if (x != 0) {
+        point(surface, clipping_region, cx - x, cy + y, index, blending);
+    }
+    if (y != 0) {
+        point(surface, clipping_region, cx + x, cy - y, index, blending);
+    }
+    if (x != 0 && y != 0) {
+        point(surface, clipping_region, cx - x, cy - y, index, blending);
+    }
+}
+
 void GL_primitive_circle(const GL_Context_t *context, GL_Point_t center, int radius, GL_Pixel_t index)
 {
+    if (context->queue) {
+        GL_queue_circle(context->queue, &context->state, center, radius, index);
+        return;
+    }
+
     const GL_State_t *state = &context->state;
     const GL_Quad_t *clipping_region = &state->clipping_region;
     const GL_Pixel_t *shifting = state->shifting;
@@ -620,19 +829,19 @@ void GL_primitive_circle(const GL_Context_t *context, GL_Point_t center, int rad
     const int cx = center.x;
     const int cy = center.y;
 
+    touch(state, cy - radius, cy + radius);
+
+    const GL_Pixel_t *blending = state->blending;
+
     int x = 0;
     int y = radius;
     int d = 3 - 2 * radius;
 
     while (x <= y) {
-        point(surface, clipping_region, cx + x, cy + y, index);
-        point(surface, clipping_region, cx + y, cy + x, index);
-        point(surface, clipping_region, cx - y, cy + x, index);
-        point(surface, clipping_region, cx - x, cy + y, index);
-        point(surface, clipping_region, cx - x, cy - y, index);
-        point(surface, clipping_region, cx - y, cy - x, index);
-        point(surface, clipping_region, cx + y, cy - x, index);
-        point(surface, clipping_region, cx + x, cy - y, index);
+        quadrants(surface, clipping_region, cx, cy, x, y, index, blending);
+        if (x != y) { // On the diagonal the two octants meet.
+            quadrants(surface, clipping_region, cx, cy, y, x, index, blending);
+        }
 
         if (d < 0) {
             d += 4 * x + 6;
@@ -645,9 +854,209 @@ void GL_primitive_circle(const GL_Context_t *context, GL_Point_t center, int rad
     }
 }
 
+static inline void textured_pixel(GL_Pixel_t *dptr, const GL_Surface_t *surface, fixed64_t u, fixed64_t v, const GL_Pixel_t *shifting, const GL_Bool_t *transparent, const GL_Pixel_t *blending)
+{
+    const int su = FIXED64_TO_INT(u);
+    const int sv = FIXED64_TO_INT(v);
+    const int sx = su < 0 ? 0 : (su >= (int)surface->width ? (int)surface->width - 1 : su); // Clamp to the edge, so that
+    const int sy = sv < 0 ? 0 : (sv >= (int)surface->height ? (int)surface->height - 1 : sv); // rounding can't overrun.
+
+    GL_Pixel_t index = shifting[surface->data[sy * surface->stride + sx]];
+    if (!transparent[index]) {
+        plot(dptr, index, blending);
+    }
+}
+
+// Affine texture mapping, same tiled rasterization as `GL_primitive_filled_triangle()` but with a strict top-left
+// fill rule, so that triangles sharing an edge (e.g. the two halves of a quad) never overlap. Texture coordinates are
+// sampled at the pixel centers and stepped in 32.32 fixed-point.
+void GL_primitive_textured_triangle(const GL_Context_t *context, const GL_Surface_t *surface, GL_Vertex_t a, GL_Vertex_t b, GL_Vertex_t c)
+{
+    if (context->queue) {
+        GL_queue_textured_triangle(context->queue, &context->state, surface, a, b, c);
+        return;
+    }
+
+    const GL_State_t *state = &context->state;
+    const GL_Quad_t *clipping_region = &state->clipping_region;
+    const GL_Pixel_t *shifting = state->shifting;
+    const GL_Bool_t *transparent = state->transparent;
+    const GL_Pixel_t *blending = state->blending;
+    const GL_Surface_t *target = state->surface;
+
+    GL_Quad_t drawing_region = (GL_Quad_t){
+            .x0 = imin(imin(a.x, b.x), c.x),
+            .y0 = imin(imin(a.y, b.y), c.y),
+            .x1 = imax(imax(a.x, b.x), c.x),
+            .y1 = imax(imax(a.y, b.y), c.y)
+        };
+    const GL_Point_t origin = (GL_Point_t){ .x = drawing_region.x0, .y = drawing_region.y0 };
+
+    if (drawing_region.x0 < clipping_region->x0) {
+        drawing_region.x0 = clipping_region->x0;
+    }
+    if (drawing_region.y0 < clipping_region->y0) {
+        drawing_region.y0 = clipping_region->y0;
+    }
+    if (drawing_region.x1 > clipping_region->x1) {
+        drawing_region.x1 = clipping_region->x1;
+    }
+    if (drawing_region.y1 > clipping_region->y1) {
+        drawing_region.y1 = clipping_region->y1;
+    }
+
+    const int width = drawing_region.x1 - drawing_region.x0 + 1;
+    const int height = drawing_region.y1 - drawing_region.y0 + 1;
+    if ((width <= 0) || (height <= 0)) { // Nothing to draw! Bail out!
+        return;
+    }
+
+    GL_surface_touch(target, drawing_region.y0, drawing_region.y1);
+
+    int area = (b.x - a.x) * (c.y - a.y) - (c.x - a.x) * (b.y - a.y);
+    if (area == 0) { // Degenerate triangle, the texture coordinates can't be interpolated.
+        return;
+    } else
+    if (area > 0) { // Ensure CCW winding.
+        GL_Vertex_t t = a;
+        a = b;
+        b = t;
+        area = -area;
+    }
+
+    int DX12 = a.x - b.x;
+    int DX23 = b.x - c.x;
+    int DX31 = c.x - a.x;
+    int DY12 = a.y - b.y;
+    int DY23 = b.y - c.y;
+    int DY31 = c.y - a.y;
+
+    int C1 = DY12 * a.x - DX12 * a.y;
+    int C2 = DY23 * b.x - DX23 * b.y;
+    int C3 = DY31 * c.x - DX31 * c.y;
+
+    // Pixels lying exactly on an edge are drawn only for top and left edges.
+    if (!((DY12 < 0) || ((DY12 == 0) && (DX12 > 0)))) { C1 -= 1; }
+    if (!((DY23 < 0) || ((DY23 == 0) && (DX23 > 0)))) { C2 -= 1; }
+    if (!((DY31 < 0) || ((DY31 == 0) && (DX31 > 0)))) { C3 -= 1; }
+
+    // The texture coordinates are a linear function of the position, find its gradients (barycentric interpolation).
+    const double ub = (double)b.u - (double)a.u, uc = (double)c.u - (double)a.u;
+    const double vb = (double)b.v - (double)a.v, vc = (double)c.v - (double)a.v;
+    const int bx = b.x - a.x, by = b.y - a.y;
+    const int cx = c.x - a.x, cy = c.y - a.y;
+
+    const double dudx = (ub * cy - uc * by) / area;
+    const double dudy = (uc * bx - ub * cx) / area;
+    const double dvdx = (vb * cy - vc * by) / area;
+    const double dvdy = (vc * bx - vb * cx) / area;
+
+    const fixed64_t du_dx = FIXED64_FROM_FLOAT(dudx);
+    const fixed64_t du_dy = FIXED64_FROM_FLOAT(dudy);
+    const fixed64_t dv_dx = FIXED64_FROM_FLOAT(dvdx);
+    const fixed64_t dv_dy = FIXED64_FROM_FLOAT(dvdy);
+
+    // Evaluate at the (unclipped) bounding box origin and step in fixed-point to the clipped one, so that the texture
+    // coordinates of a pixel don't depend on the clipping region.
+    const double ox = (origin.x + 0.5) - a.x;
+    const double oy = (origin.y + 0.5) - a.y;
+
+    fixed64_t UY = FIXED64_FROM_FLOAT(a.u + dudx * ox + dudy * oy)
+        + (drawing_region.x0 - origin.x) * du_dx + (drawing_region.y0 - origin.y) * du_dy;
+    fixed64_t VY = FIXED64_FROM_FLOAT(a.v + dvdx * ox + dvdy * oy)
+        + (drawing_region.x0 - origin.x) * dv_dx + (drawing_region.y0 - origin.y) * dv_dy;
+
+    GL_Pixel_t *ddata = target->data;
+
+    const int dstride = target->stride;
+
+    int CY1 = C1 + DX12 * drawing_region.y0 - DY12 * drawing_region.x0;
+    int CY2 = C2 + DX23 * drawing_region.y0 - DY23 * drawing_region.x0;
+    int CY3 = C3 + DX31 * drawing_region.y0 - DY31 * drawing_region.x0;
+
+    GL_Pixel_t *drow = ddata + drawing_region.y0 * dstride + drawing_region.x0;
+
+    for (int ty = 0; ty < height; ty += TRIANGLE_TILE_SIZE) {
+        const int th = imin(TRIANGLE_TILE_SIZE, height - ty);
+
+        for (int tx = 0; tx < width; tx += TRIANGLE_TILE_SIZE) {
+            const int tw = imin(TRIANGLE_TILE_SIZE, width - tx);
+
+            const int E1 = CY1 - DY12 * tx;
+            const int E2 = CY2 - DY23 * tx;
+            const int E3 = CY3 - DY31 * tx;
+
+            const int c1 = classify_tile(E1, DX12, DY12, tw, th);
+            const int c2 = classify_tile(E2, DX23, DY23, tw, th);
+            const int c3 = classify_tile(E3, DX31, DY31, tw, th);
+
+            if ((c1 == TILE_OUTSIDE) || (c2 == TILE_OUTSIDE) || (c3 == TILE_OUTSIDE)) {
+                continue;
+            }
+
+            const bool inside = (c1 == TILE_INSIDE) && (c2 == TILE_INSIDE) && (c3 == TILE_INSIDE);
+
+            GL_Pixel_t *dptr = drow + tx;
+            fixed64_t UX = UY + du_dx * tx;
+            fixed64_t VX = VY + dv_dx * tx;
+
+            int CX1 = E1;
+            int CX2 = E2;
+            int CX3 = E3;
+            for (int y = 0; y < th; ++y) {
+                fixed64_t u = UX;
+                fixed64_t v = VX;
+                if (inside) {
+                    for (int x = 0; x < tw; ++x) {
+                        textured_pixel(dptr + x, surface, u, v, shifting, transparent, blending);
+                        u += du_dx;
+                        v += dv_dx;
+                    }
+                } else {
+                    int EX1 = CX1;
+                    int EX2 = CX2;
+                    int EX3 = CX3;
+                    for (int x = 0; x < tw; ++x) {
+                        if ((EX1 | EX2 | EX3) >= 0) { // Check the sign bit only.
+                            textured_pixel(dptr + x, surface, u, v, shifting, transparent, blending);
+                        }
+                        EX1 -= DY12;
+                        EX2 -= DY23;
+                        EX3 -= DY31;
+                        u += du_dx;
+                        v += dv_dx;
+                    }
+                }
+                CX1 += DX12;
+                CX2 += DX23;
+                CX3 += DX31;
+                UX += du_dy;
+                VX += dv_dy;
+                dptr += dstride;
+            }
+        }
+
+        CY1 += DX12 * th;
+        CY2 += DX23 * th;
+        CY3 += DX31 * th;
+        UY += du_dy * th;
+        VY += dv_dy * th;
+        drow += dstride * th;
+    }
+}
+
+// The quad is split along the `a`-`c` diagonal; being affine, non-parallelogram quads show the seam.
+void GL_primitive_textured_quad(const GL_Context_t *context, const GL_Surface_t *surface, GL_Vertex_t a, GL_Vertex_t b, GL_Vertex_t c, GL_Vertex_t d)
+{
+    GL_primitive_textured_triangle(context, surface, a, b, c);
+    GL_primitive_textured_triangle(context, surface, a, c, d);
+}
+
 // https://lodev.org/cgtutor/floodfill.html
 void GL_context_fill(const GL_Context_t *context, GL_Point_t seed, GL_Pixel_t index)
 {
+    GL_context_flush(context); // Reads back the surface, pending commands need to be drawn.
+
     const GL_State_t *state = &context->state;
     const GL_Quad_t *clipping_region = &state->clipping_region;
     const GL_Pixel_t *shifting = state->shifting;
@@ -658,17 +1067,19 @@ void GL_context_fill(const GL_Context_t *context, GL_Point_t seed, GL_Pixel_t in
         return;
     }
 
+    touch(state, clipping_region->y0, clipping_region->y1); // Can't tell in advance, assume the worst.
+
     GL_Pixel_t *ddata = surface->data;
 
-    const int dwidth = surface->width;
+    const int dstride = surface->stride;
 
-    const GL_Pixel_t match = ddata[seed.y * dwidth + seed.x];
+    const GL_Pixel_t match = ddata[seed.y * dstride + seed.x];
     const GL_Pixel_t replacement = shifting[index];
 
     GL_Point_t *stack = NULL;
     arrpush(stack, seed);
 
-    const int dskip = state->surface->width;
+    const int dskip = state->surface->stride;
 
     while (arrlen(stack) > 0) {
         const GL_Point_t position = arrpop(stack);
@@ -676,7 +1087,7 @@ void GL_context_fill(const GL_Context_t *context, GL_Point_t seed, GL_Pixel_t in
         int x = position.x;
         int y = position.y;
 
-        GL_Pixel_t *dptr = ddata + y * dwidth + x;
+        GL_Pixel_t *dptr = ddata + y * dstride + x;
         while (x >= clipping_region->x0 && *dptr == match) {
             --x;
             --dptr;
@@ -26,6 +26,11 @@
 #include "common.h"
 #include "context.h"
 
+typedef struct _GL_Vertex_t {
+    int x, y; // Destination position.
+    float u, v; // Source texture coordinates, in texels.
+} GL_Vertex_t;
+
 extern void GL_primitive_point(const GL_Context_t *context, GL_Point_t position, GL_Pixel_t index);
 extern void GL_primitive_hline(const GL_Context_t *context, GL_Point_t origin,  size_t w, GL_Pixel_t index);
 extern void GL_primitive_vline(const GL_Context_t *context, GL_Point_t origin, size_t h, GL_Pixel_t index);
@@ -37,6 +42,8 @@ extern void GL_primitive_filled_rectangle(const GL_Context_t *context, GL_Rectan
 extern void GL_primitive_filled_triangle(const GL_Context_t *context, GL_Point_t a, GL_Point_t b, GL_Point_t c, GL_Pixel_t index);
 extern void GL_primitive_filled_circle(const GL_Context_t *context, GL_Point_t center, int radius, GL_Pixel_t index);
 extern void GL_primitive_circle(const GL_Context_t *context, GL_Point_t center, int radius, GL_Pixel_t index);
+extern void GL_primitive_textured_triangle(const GL_Context_t *context, const GL_Surface_t *surface, GL_Vertex_t a, GL_Vertex_t b, GL_Vertex_t c);
+extern void GL_primitive_textured_quad(const GL_Context_t *context, const GL_Surface_t *surface, GL_Vertex_t a, GL_Vertex_t b, GL_Vertex_t c, GL_Vertex_t d);
 
 extern void GL_context_fill(const GL_Context_t *context, GL_Point_t seed, GL_Pixel_t index);
 
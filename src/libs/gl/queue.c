@@ -0,0 +1,852 @@
+/*
+ * Copyright (c) 2019-2020 by Marco Lizza (marco.lizza@gmail.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+#include "queue.h"
+
+#include <config.h>
+#include <libs/imath.h>
+#include <libs/log.h>
+#include <libs/stb.h>
+
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LOG_CONTEXT "gl-queue"
+
+#define GL_QUEUE_MAX_OCCLUDERS      16
+#define GL_QUEUE_MAX_TARGETS        8
+#define GL_QUEUE_MAX_WINDOW         32
+#define GL_QUEUE_MAX_WORKERS        16
+#define GL_QUEUE_MIN_BATCH          8
+
+#define ARRAY_EMPTY(a)  do { if (a) { arrdeln((a), 0, arrlen(a)); } } while (0)
+
+typedef struct _Occluder_t {
+    const GL_Surface_t *surface;
+    GL_Quad_t area;
+} Occluder_t;
+
+typedef struct _GL_Worker_t {
+    struct _GL_Pool_t *pool;
+    size_t band;
+    pthread_t thread;
+} GL_Worker_t;
+
+// Persistent set of threads, woken up once per batch of banded commands. Each batch is identified by a generation
+// counter so that a worker never processes the same batch twice (or misses one).
+typedef struct _GL_Pool_t {
+    pthread_mutex_t mutex;
+    pthread_cond_t wake, done;
+    size_t generation;
+    size_t pending;
+    bool quit;
+    const GL_Queue_t *queue;
+    const GL_Context_t *context;
+    size_t from, to;
+    GL_Worker_t workers[GL_QUEUE_MAX_WORKERS];
+    size_t count;
+} GL_Pool_t;
+
+static void replay_band(const GL_Queue_t *queue, const GL_Context_t *context, size_t from, size_t to, size_t band);
+
+static void *worker_main(void *arg)
+{
+    GL_Worker_t *worker = (GL_Worker_t *)arg;
+    GL_Pool_t *pool = worker->pool;
+
+    size_t generation = 0;
+    for (;;) {
+        pthread_mutex_lock(&pool->mutex);
+        while (!pool->quit && pool->generation == generation) {
+            pthread_cond_wait(&pool->wake, &pool->mutex);
+        }
+        if (pool->quit) {
+            pthread_mutex_unlock(&pool->mutex);
+            break;
+        }
+        generation = pool->generation;
+        pthread_mutex_unlock(&pool->mutex);
+
+        replay_band(pool->queue, pool->context, pool->from, pool->to, worker->band);
+
+        pthread_mutex_lock(&pool->mutex);
+        if (--pool->pending == 0) {
+            pthread_cond_signal(&pool->done);
+        }
+        pthread_mutex_unlock(&pool->mutex);
+    }
+
+    return NULL;
+}
+
+static void pool_delete(GL_Pool_t *pool)
+{
+    pthread_mutex_lock(&pool->mutex);
+    pool->quit = true;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->mutex);
+
+    for (size_t i = 0; i < pool->count; ++i) {
+        pthread_join(pool->workers[i].thread, NULL);
+    }
+
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->wake);
+    pthread_mutex_destroy(&pool->mutex);
+    free(pool);
+}
+
+// The calling thread is a worker on its own, `count` is the amount of *additional* threads.
+static GL_Pool_t *pool_create(size_t count)
+{
+    GL_Pool_t *pool = malloc(sizeof(GL_Pool_t));
+    if (!pool) {
+        return NULL;
+    }
+    *pool = (GL_Pool_t){ 0 };
+
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    for (size_t i = 0; i < count; ++i) {
+        GL_Worker_t *worker = &pool->workers[i];
+        *worker = (GL_Worker_t){ .pool = pool, .band = i + 1 };
+        if (pthread_create(&worker->thread, NULL, worker_main, worker) != 0) {
+            Log_write(LOG_LEVELS_ERROR, LOG_CONTEXT, "can't create worker #%d", i);
+            pool_delete(pool);
+            return NULL;
+        }
+        pool->count += 1;
+    }
+
+    return pool;
+}
+
+static void pool_run(GL_Pool_t *pool, const GL_Queue_t *queue, const GL_Context_t *context, size_t from, size_t to)
+{
+    pthread_mutex_lock(&pool->mutex);
+    pool->queue = queue;
+    pool->context = context;
+    pool->from = from;
+    pool->to = to;
+    pool->pending = pool->count;
+    pool->generation += 1;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->mutex);
+
+    replay_band(queue, context, from, to, 0);
+
+    pthread_mutex_lock(&pool->mutex);
+    while (pool->pending > 0) {
+        pthread_cond_wait(&pool->done, &pool->mutex);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+bool GL_queue_create(GL_Queue_t *queue, size_t workers)
+{
+    *queue = (GL_Queue_t){ 0 };
+
+    if (workers > GL_QUEUE_MAX_WORKERS) {
+        Log_write(LOG_LEVELS_WARNING, LOG_CONTEXT, "too many workers (%d), capping to %d", workers, GL_QUEUE_MAX_WORKERS);
+        workers = GL_QUEUE_MAX_WORKERS;
+    }
+
+    if (workers > 1) {
+        queue->pool = pool_create(workers - 1);
+        if (!queue->pool) {
+            Log_write(LOG_LEVELS_WARNING, LOG_CONTEXT, "can't create workers pool, replaying on a single thread");
+        } else {
+            queue->workers = workers;
+            Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "workers pool created w/ %d bands", workers);
+        }
+    }
+
+    Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "queue created");
+    return true;
+}
+
+void GL_queue_delete(GL_Queue_t *queue)
+{
+    if (queue->pool) {
+        pool_delete(queue->pool);
+        Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "workers pool deleted");
+    }
+
+    arrfree(queue->commands);
+    arrfree(queue->states);
+    arrfree(queue->vertices);
+    arrfree(queue->entries);
+
+    Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "queue deleted");
+}
+
+// Consecutive commands usually share the same state, store a new snapshot only when it changes.
+static inline size_t snapshot(GL_Queue_t *queue, const GL_State_t *state)
+{
+    const size_t count = arrlen(queue->states);
+    if (count > 0 && memcmp(&queue->states[count - 1], state, sizeof(GL_State_t)) == 0) {
+        return count - 1;
+    }
+    arrpush(queue->states, *state);
+    return count;
+}
+
+static inline GL_Quad_t clip(GL_Quad_t bounds, const GL_Quad_t *clipping_region)
+{
+    return (GL_Quad_t){
+            .x0 = imax(bounds.x0, clipping_region->x0),
+            .y0 = imax(bounds.y0, clipping_region->y0),
+            .x1 = imin(bounds.x1, clipping_region->x1),
+            .y1 = imin(bounds.y1, clipping_region->y1)
+        };
+}
+
+// Commands lying completely outside the clipping region are culled right away, w/o being recorded.
+static GL_Command_t *push(GL_Queue_t *queue, const GL_State_t *state, GL_Command_Types_t type, GL_Quad_t bounds, const GL_Surface_t *source)
+{
+    if ((bounds.x0 > bounds.x1) || (bounds.y0 > bounds.y1)) {
+        return NULL;
+    }
+    const GL_Command_t command = (GL_Command_t){ .type = type, .state = snapshot(queue, state), .bounds = bounds, .source = source };
+    arrpush(queue->commands, command);
+    return &arrlast(queue->commands);
+}
+
+void GL_queue_clear(GL_Queue_t *queue, const GL_State_t *state)
+{
+    const GL_Surface_t *surface = state->surface;
+    const GL_Quad_t bounds = (GL_Quad_t){ .x0 = 0, .y0 = 0, .x1 = surface->width - 1, .y1 = surface->height - 1 }; // Ignores the clipping region.
+    push(queue, state, GL_COMMAND_CLEAR, bounds, NULL);
+}
+
+void GL_queue_blit(GL_Queue_t *queue, const GL_State_t *state, const GL_Surface_t *surface, GL_Rectangle_t area, GL_Point_t position)
+{
+    const GL_Quad_t bounds = (GL_Quad_t){ .x0 = position.x, .y0 = position.y, .x1 = position.x + (int)area.width - 1, .y1 = position.y + (int)area.height - 1 };
+    GL_Command_t *command = push(queue, state, GL_COMMAND_BLIT, clip(bounds, &state->clipping_region), surface);
+    if (!command) {
+        return;
+    }
+    command->as.blit.area = area;
+    command->as.blit.position = position;
+}
+
+void GL_queue_blit_spans(GL_Queue_t *queue, const GL_State_t *state, const GL_Surface_t *surface, const GL_Spans_t *spans, GL_Rectangle_t area, GL_Point_t position)
+{
+    const GL_Quad_t bounds = (GL_Quad_t){ .x0 = position.x, .y0 = position.y, .x1 = position.x + (int)area.width - 1, .y1 = position.y + (int)area.height - 1 };
+    GL_Command_t *command = push(queue, state, GL_COMMAND_BLIT_SPANS, clip(bounds, &state->clipping_region), surface);
+    if (!command) {
+        return;
+    }
+    command->as.blit_spans.spans = *spans;
+    command->as.blit_spans.area = area;
+    command->as.blit_spans.position = position;
+}
+
+void GL_queue_blit_s(GL_Queue_t *queue, const GL_State_t *state, const GL_Surface_t *surface, GL_Rectangle_t area, GL_Point_t position, float scale_x, float scale_y)
+{
+    const int drawing_width = (int)((float)(area.width * fabsf(scale_x)) + 0.5f);
+    const int drawing_height = (int)((float)(area.height * fabsf(scale_y)) + 0.5f);
+    const GL_Quad_t bounds = (GL_Quad_t){ .x0 = position.x, .y0 = position.y, .x1 = position.x + drawing_width - 1, .y1 = position.y + drawing_height - 1 };
+    GL_Command_t *command = push(queue, state, GL_COMMAND_BLIT_S, clip(bounds, &state->clipping_region), surface);
+    if (!command) {
+        return;
+    }
+    command->as.blit_s.area = area;
+    command->as.blit_s.position = position;
+    command->as.blit_s.scale_x = scale_x;
+    command->as.blit_s.scale_y = scale_y;
+}
+
+void GL_queue_blit_sr(GL_Queue_t *queue, const GL_State_t *state, const GL_Surface_t *surface, GL_Rectangle_t area, GL_Point_t position, float scale_x, float scale_y, int rotation, float anchor_x, float anchor_y)
+{
+    // Whatever the rotation, the image lies within the circle centered on the anchor and reaching the farthest corner.
+    const float sw = fabsf((float)area.width * scale_x);
+    const float sh = fabsf((float)area.height * scale_y);
+    const float dx = fmaxf(fabsf(sw * anchor_x), fabsf(sw * (1.0f - anchor_x)));
+    const float dy = fmaxf(fabsf(sh * anchor_y), fabsf(sh * (1.0f - anchor_y)));
+    const int radius = (int)ceilf(sqrtf(dx * dx + dy * dy)) + 1;
+    const GL_Quad_t bounds = (GL_Quad_t){ .x0 = position.x - radius, .y0 = position.y - radius, .x1 = position.x + radius, .y1 = position.y + radius };
+    GL_Command_t *command = push(queue, state, GL_COMMAND_BLIT_SR, clip(bounds, &state->clipping_region), surface);
+    if (!command) {
+        return;
+    }
+    command->as.blit_sr.area = area;
+    command->as.blit_sr.position = position;
+    command->as.blit_sr.scale_x = scale_x;
+    command->as.blit_sr.scale_y = scale_y;
+    command->as.blit_sr.rotation = rotation;
+    command->as.blit_sr.anchor_x = anchor_x;
+    command->as.blit_sr.anchor_y = anchor_y;
+}
+
+void GL_queue_blit_x(GL_Queue_t *queue, const GL_State_t *state, const GL_Surface_t *surface, GL_Point_t position, const GL_XForm_t *xform)
+{
+    GL_Command_t *command = push(queue, state, GL_COMMAND_BLIT_X, state->clipping_region, surface); // Can span the whole region.
+    if (!command) {
+        return;
+    }
+    command->as.blit_x.position = position;
+    command->as.blit_x.xform = *xform;
+    if (xform->table) { // The table can be changed (or released) before the replay, keep a copy.
+        command->as.blit_x.table = arrlen(queue->entries);
+        for (const GL_XForm_Table_Entry_t *entry = xform->table; ; ++entry) {
+            arrpush(queue->entries, *entry);
+            if (entry->scan_line == -1) {
+                break;
+            }
+        }
+    }
+}
+
+void GL_queue_point(GL_Queue_t *queue, const GL_State_t *state, GL_Point_t position, GL_Pixel_t index)
+{
+    const GL_Quad_t bounds = (GL_Quad_t){ .x0 = position.x, .y0 = position.y, .x1 = position.x, .y1 = position.y };
+    GL_Command_t *command = push(queue, state, GL_COMMAND_POINT, clip(bounds, &state->clipping_region), NULL);
+    if (!command) {
+        return;
+    }
+    command->as.line.position = position;
+    command->as.line.index = index;
+}
+
+void GL_queue_hline(GL_Queue_t *queue, const GL_State_t *state, GL_Point_t origin, size_t w, GL_Pixel_t index)
+{
+    const GL_Quad_t bounds = (GL_Quad_t){ .x0 = origin.x, .y0 = origin.y, .x1 = origin.x + (int)w - 1, .y1 = origin.y };
+    GL_Command_t *command = push(queue, state, GL_COMMAND_HLINE, clip(bounds, &state->clipping_region), NULL);
+    if (!command) {
+        return;
+    }
+    command->as.line.position = origin;
+    command->as.line.length = w;
+    command->as.line.index = index;
+}
+
+void GL_queue_vline(GL_Queue_t *queue, const GL_State_t *state, GL_Point_t origin, size_t h, GL_Pixel_t index)
+{
+    const GL_Quad_t bounds = (GL_Quad_t){ .x0 = origin.x, .y0 = origin.y, .x1 = origin.x, .y1 = origin.y + (int)h - 1 };
+    GL_Command_t *command = push(queue, state, GL_COMMAND_VLINE, clip(bounds, &state->clipping_region), NULL);
+    if (!command) {
+        return;
+    }
+    command->as.line.position = origin;
+    command->as.line.length = h;
+    command->as.line.index = index;
+}
+
+void GL_queue_polyline(GL_Queue_t *queue, const GL_State_t *state, const GL_Point_t *vertices, size_t count, GL_Pixel_t index)
+{
+    if (count == 0) {
+        return;
+    }
+    GL_Quad_t bounds = (GL_Quad_t){ .x0 = vertices[0].x, .y0 = vertices[0].y, .x1 = vertices[0].x, .y1 = vertices[0].y };
+    for (size_t i = 1; i < count; ++i) {
+        bounds.x0 = imin(bounds.x0, vertices[i].x);
+        bounds.y0 = imin(bounds.y0, vertices[i].y);
+        bounds.x1 = imax(bounds.x1, vertices[i].x);
+        bounds.y1 = imax(bounds.y1, vertices[i].y);
+    }
+    GL_Command_t *command = push(queue, state, GL_COMMAND_POLYLINE, clip(bounds, &state->clipping_region), NULL);
+    if (!command) {
+        return;
+    }
+    command->as.polyline.vertices = arrlen(queue->vertices);
+    command->as.polyline.count = count;
+    command->as.polyline.index = index;
+    for (size_t i = 0; i < count; ++i) {
+        arrpush(queue->vertices, vertices[i]);
+    }
+}
+
+// Adjacent rectangles sharing a whole edge (e.g. a row of tiles) are merged into a single one.
+static inline bool merge_rectangles(GL_Rectangle_t *rectangle, GL_Rectangle_t other)
+{
+    if ((rectangle->y == other.y) && (rectangle->height == other.height)) {
+        if (rectangle->x + (int)rectangle->width == other.x) {
+            rectangle->width += other.width;
+            return true;
+        } else
+        if (other.x + (int)other.width == rectangle->x) {
+            rectangle->x = other.x;
+            rectangle->width += other.width;
+            return true;
+        }
+    } else
+    if ((rectangle->x == other.x) && (rectangle->width == other.width)) {
+        if (rectangle->y + (int)rectangle->height == other.y) {
+            rectangle->height += other.height;
+            return true;
+        } else
+        if (other.y + (int)other.height == rectangle->y) {
+            rectangle->y = other.y;
+            rectangle->height += other.height;
+            return true;
+        }
+    }
+    return false;
+}
+
+void GL_queue_filled_rectangle(GL_Queue_t *queue, const GL_State_t *state, GL_Rectangle_t rectangle, GL_Pixel_t index)
+{
+    const GL_Quad_t bounds = (GL_Quad_t){ .x0 = rectangle.x, .y0 = rectangle.y, .x1 = rectangle.x + (int)rectangle.width - 1, .y1 = rectangle.y + (int)rectangle.height - 1 };
+
+    const size_t count = arrlen(queue->commands);
+    if (count > 0) {
+        GL_Command_t *last = &queue->commands[count - 1];
+        if ((last->type == GL_COMMAND_FILLED_RECTANGLE) && (last->as.rectangle.index == index)
+            && (last->state == snapshot(queue, state)) && merge_rectangles(&last->as.rectangle.rectangle, rectangle)) {
+            const GL_Rectangle_t *merged = &last->as.rectangle.rectangle;
+            last->bounds = clip((GL_Quad_t){ .x0 = merged->x, .y0 = merged->y, .x1 = merged->x + (int)merged->width - 1, .y1 = merged->y + (int)merged->height - 1 }, &state->clipping_region);
+            return;
+        }
+    }
+
+    GL_Command_t *command = push(queue, state, GL_COMMAND_FILLED_RECTANGLE, clip(bounds, &state->clipping_region), NULL);
+    if (!command) {
+        return;
+    }
+    command->as.rectangle.rectangle = rectangle;
+    command->as.rectangle.index = index;
+}
+
+void GL_queue_filled_triangle(GL_Queue_t *queue, const GL_State_t *state, GL_Point_t a, GL_Point_t b, GL_Point_t c, GL_Pixel_t index)
+{
+    const GL_Quad_t bounds = (GL_Quad_t){
+            .x0 = imin(imin(a.x, b.x), c.x),
+            .y0 = imin(imin(a.y, b.y), c.y),
+            .x1 = imax(imax(a.x, b.x), c.x),
+            .y1 = imax(imax(a.y, b.y), c.y)
+        };
+    GL_Command_t *command = push(queue, state, GL_COMMAND_FILLED_TRIANGLE, clip(bounds, &state->clipping_region), NULL);
+    if (!command) {
+        return;
+    }
+    command->as.triangle.a = a;
+    command->as.triangle.b = b;
+    command->as.triangle.c = c;
+    command->as.triangle.index = index;
+}
+
+void GL_queue_filled_circle(GL_Queue_t *queue, const GL_State_t *state, GL_Point_t center, int radius, GL_Pixel_t index)
+{
+    const GL_Quad_t bounds = (GL_Quad_t){ .x0 = center.x - radius, .y0 = center.y - radius, .x1 = center.x + radius, .y1 = center.y + radius };
+    GL_Command_t *command = push(queue, state, GL_COMMAND_FILLED_CIRCLE, clip(bounds, &state->clipping_region), NULL);
+    if (!command) {
+        return;
+    }
+    command->as.circle.center = center;
+    command->as.circle.radius = radius;
+    command->as.circle.index = index;
+}
+
+void GL_queue_circle(GL_Queue_t *queue, const GL_State_t *state, GL_Point_t center, int radius, GL_Pixel_t index)
+{
+    const GL_Quad_t bounds = (GL_Quad_t){ .x0 = center.x - radius, .y0 = center.y - radius, .x1 = center.x + radius, .y1 = center.y + radius };
+    GL_Command_t *command = push(queue, state, GL_COMMAND_CIRCLE, clip(bounds, &state->clipping_region), NULL);
+    if (!command) {
+        return;
+    }
+    command->as.circle.center = center;
+    command->as.circle.radius = radius;
+    command->as.circle.index = index;
+}
+
+void GL_queue_textured_triangle(GL_Queue_t *queue, const GL_State_t *state, const GL_Surface_t *surface, GL_Vertex_t a, GL_Vertex_t b, GL_Vertex_t c)
+{
+    const GL_Quad_t bounds = (GL_Quad_t){
+            .x0 = imin(imin(a.x, b.x), c.x),
+            .y0 = imin(imin(a.y, b.y), c.y),
+            .x1 = imax(imax(a.x, b.x), c.x),
+            .y1 = imax(imax(a.y, b.y), c.y)
+        };
+    GL_Command_t *command = push(queue, state, GL_COMMAND_TEXTURED_TRIANGLE, clip(bounds, &state->clipping_region), surface);
+    if (!command) {
+        return;
+    }
+    command->as.textured_triangle.a = a;
+    command->as.textured_triangle.b = b;
+    command->as.textured_triangle.c = c;
+}
+
+static inline bool contains(const GL_Quad_t *outer, const GL_Quad_t *inner)
+{
+    return (inner->x0 >= outer->x0) && (inner->y0 >= outer->y0) && (inner->x1 <= outer->x1) && (inner->y1 <= outer->y1);
+}
+
+static inline bool overlaps(const GL_Quad_t *a, const GL_Quad_t *b)
+{
+    return (a->x0 <= b->x1) && (b->x0 <= a->x1) && (a->y0 <= b->y1) && (b->y0 <= a->y1);
+}
+
+static inline size_t area_of(const GL_Quad_t *quad)
+{
+    return (size_t)(quad->x1 - quad->x0 + 1) * (size_t)(quad->y1 - quad->y0 + 1);
+}
+
+// A command fully overwrites its bounds when no pixel can be skipped as transparent.
+static inline bool is_opaque(const GL_Command_t *command, const GL_State_t *state)
+{
+    if (command->type == GL_COMMAND_CLEAR) {
+        return true;
+    } else
+    if (command->type == GL_COMMAND_FILLED_RECTANGLE) {
+        return !state->transparent[state->shifting[command->as.rectangle.index]] && !state->fingerprint.blended;
+    } else
+    if (command->type == GL_COMMAND_BLIT) {
+        return state->fingerprint.transparent == 0 && !state->fingerprint.masked && !state->fingerprint.blended;
+    }
+    return false;
+}
+
+// Walk the commands backwards, tracking the opaque areas drawn later on: anything completely covered by one of them
+// won't be visible and can be skipped. When a surface is used as a source, what's been drawn on it up to that point
+// is needed, so the occluders of the surfaces sharing its pixels (e.g. a view and its parent) are dropped.
+static void cull(GL_Queue_t *queue)
+{
+    Occluder_t occluders[GL_QUEUE_MAX_OCCLUDERS];
+    size_t count = 0;
+
+    for (int i = arrlen(queue->commands) - 1; i >= 0; --i) {
+        GL_Command_t *command = &queue->commands[i];
+        const GL_State_t *state = &queue->states[command->state];
+
+        for (size_t j = 0; j < count; ++j) {
+            if (occluders[j].surface == state->surface && contains(&occluders[j].area, &command->bounds)) {
+                command->culled = true;
+                break;
+            }
+        }
+        if (command->culled) {
+            continue;
+        }
+
+        if (command->source) {
+            for (size_t j = 0; j < count; ) {
+                if (GL_surface_aliases(occluders[j].surface, command->source)) {
+                    occluders[j] = occluders[--count];
+                } else {
+                    ++j;
+                }
+            }
+        }
+
+        if (!is_opaque(command, state) || (command->source && GL_surface_aliases(command->source, state->surface))) { // Self-blits read what's beneath.
+            continue;
+        }
+
+        const Occluder_t occluder = (Occluder_t){ .surface = state->surface, .area = command->bounds };
+        if (count < GL_QUEUE_MAX_OCCLUDERS) {
+            occluders[count++] = occluder;
+        } else { // Replace the smallest occluder, if bigger.
+            size_t smallest = 0;
+            for (size_t j = 1; j < count; ++j) {
+                if (area_of(&occluders[j].area) < area_of(&occluders[smallest].area)) {
+                    smallest = j;
+                }
+            }
+            if (area_of(&occluder.area) > area_of(&occluders[smallest].area)) {
+                occluders[smallest] = occluder;
+            }
+        }
+    }
+}
+
+// Views are matched against the surfaces they share the pixels with, too.
+static inline bool is_target(const GL_Surface_t *surface, const GL_Surface_t **targets, size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        if (GL_surface_aliases(targets[i], surface)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Commands whose (conservative) bounds don't overlap can be drawn in any order. Group the consecutive runs of such
+// commands, drawing on the same surface, and sort them by source pixels address to improve the cache locality (images
+// packed into the same atlas page end up next to each other). Commands
+// whose source is also drawn-upon in the frame are never moved.
+static void reorder(GL_Queue_t *queue)
+{
+    const GL_Surface_t *targets[GL_QUEUE_MAX_TARGETS];
+    size_t targets_count = 0;
+    for (int i = 0; i < arrlen(queue->states); ++i) {
+        const GL_Surface_t *surface = queue->states[i].surface;
+        if (is_target(surface, targets, targets_count)) {
+            continue;
+        }
+        if (targets_count == GL_QUEUE_MAX_TARGETS) {
+            return; // Too many off-screen surfaces involved, bail out.
+        }
+        targets[targets_count++] = surface;
+    }
+
+    GL_Command_t *commands = queue->commands;
+    const size_t count = arrlen(commands);
+
+    for (size_t start = 0; start < count; ) {
+        const GL_Command_t *first = &commands[start];
+        if (!first->source || is_target(first->source, targets, targets_count)) {
+            start += 1;
+            continue;
+        }
+        const GL_Surface_t *surface = queue->states[first->state].surface;
+
+        size_t end = start + 1;
+        for (; (end < count) && (end - start < GL_QUEUE_MAX_WINDOW); ++end) {
+            const GL_Command_t *command = &commands[end];
+            if (!command->source || is_target(command->source, targets, targets_count) || queue->states[command->state].surface != surface) {
+                break;
+            }
+            bool overlapping = false;
+            for (size_t i = start; i < end && !overlapping; ++i) {
+                overlapping = overlaps(&commands[i].bounds, &command->bounds);
+            }
+            if (overlapping) {
+                break;
+            }
+        }
+
+        for (size_t i = start + 1; i < end; ++i) { // Stable insertion sort, the window is small.
+            const GL_Command_t command = commands[i];
+            size_t j = i;
+            for (; (j > start) && ((uintptr_t)commands[j - 1].source->data > (uintptr_t)command.source->data); --j) {
+                commands[j] = commands[j - 1];
+            }
+            commands[j] = command;
+        }
+
+        start = end;
+    }
+}
+
+static void execute(const GL_Queue_t *queue, const GL_Context_t *context, const GL_Command_t *command)
+{
+    switch (command->type) {
+        case GL_COMMAND_CLEAR: {
+            GL_context_clear(context);
+            break;
+        }
+        case GL_COMMAND_BLIT: {
+            GL_context_blit(context, command->source, command->as.blit.area, command->as.blit.position);
+            break;
+        }
+        case GL_COMMAND_BLIT_SPANS: {
+            GL_context_blit_spans(context, command->source, &command->as.blit_spans.spans, command->as.blit_spans.area, command->as.blit_spans.position);
+            break;
+        }
+        case GL_COMMAND_BLIT_S: {
+            GL_context_blit_s(context, command->source, command->as.blit_s.area, command->as.blit_s.position,
+                command->as.blit_s.scale_x, command->as.blit_s.scale_y);
+            break;
+        }
+        case GL_COMMAND_BLIT_SR: {
+            GL_context_blit_sr(context, command->source, command->as.blit_sr.area, command->as.blit_sr.position,
+                command->as.blit_sr.scale_x, command->as.blit_sr.scale_y, command->as.blit_sr.rotation,
+                command->as.blit_sr.anchor_x, command->as.blit_sr.anchor_y);
+            break;
+        }
+        case GL_COMMAND_BLIT_X: {
+            GL_XForm_t xform = command->as.blit_x.xform;
+            if (xform.table) {
+                xform.table = queue->entries + command->as.blit_x.table;
+            }
+            GL_context_blit_x(context, command->source, command->as.blit_x.position, &xform);
+            break;
+        }
+        case GL_COMMAND_POINT: {
+            GL_primitive_point(context, command->as.line.position, command->as.line.index);
+            break;
+        }
+        case GL_COMMAND_HLINE: {
+            GL_primitive_hline(context, command->as.line.position, command->as.line.length, command->as.line.index);
+            break;
+        }
+        case GL_COMMAND_VLINE: {
+            GL_primitive_vline(context, command->as.line.position, command->as.line.length, command->as.line.index);
+            break;
+        }
+        case GL_COMMAND_POLYLINE: {
+            GL_primitive_polyline(context, queue->vertices + command->as.polyline.vertices, command->as.polyline.count, command->as.polyline.index);
+            break;
+        }
+        case GL_COMMAND_FILLED_RECTANGLE: {
+            GL_primitive_filled_rectangle(context, command->as.rectangle.rectangle, command->as.rectangle.index);
+            break;
+        }
+        case GL_COMMAND_FILLED_TRIANGLE: {
+            GL_primitive_filled_triangle(context, command->as.triangle.a, command->as.triangle.b, command->as.triangle.c, command->as.triangle.index);
+            break;
+        }
+        case GL_COMMAND_FILLED_CIRCLE: {
+            GL_primitive_filled_circle(context, command->as.circle.center, command->as.circle.radius, command->as.circle.index);
+            break;
+        }
+        case GL_COMMAND_CIRCLE: {
+            GL_primitive_circle(context, command->as.circle.center, command->as.circle.radius, command->as.circle.index);
+            break;
+        }
+        case GL_COMMAND_TEXTURED_TRIANGLE: {
+            GL_primitive_textured_triangle(context, command->source, command->as.textured_triangle.a, command->as.textured_triangle.b, command->as.textured_triangle.c);
+            break;
+        }
+        default: {
+            break;
+        }
+    }
+}
+
+// The commands are replayed in immediate mode, on a context copy w/o queue and w/ the recorded states.
+static void replay_serial(const GL_Queue_t *queue, const GL_Context_t *context, size_t from, size_t to)
+{
+    GL_Context_t replay = *context;
+    replay.queue = NULL;
+
+    size_t current = (size_t)-1;
+    for (size_t i = from; i < to; ++i) {
+        const GL_Command_t *command = &queue->commands[i];
+        if (command->culled) {
+            continue;
+        }
+        if (command->state != current) {
+            current = command->state;
+            replay.state = queue->states[current];
+        }
+        execute(queue, &replay, command);
+    }
+}
+
+// Same as the above, with the clipping region further restricted to the rows of the given band. Since the
+// rasterizers are clip-invariant (a pixel is drawn the same way regardless of the clipping region) the bands, once
+// combined, are identical to the single threaded outcome.
+static void replay_band(const GL_Queue_t *queue, const GL_Context_t *context, size_t from, size_t to, size_t band)
+{
+    const int height = (int)context->buffer.height;
+    const int y0 = (int)((size_t)height * band / queue->workers);
+    const int y1 = (int)((size_t)height * (band + 1) / queue->workers) - 1;
+    if (y0 > y1) {
+        return;
+    }
+
+    GL_Context_t replay = *context;
+    replay.queue = NULL;
+
+    size_t current = (size_t)-1;
+    for (size_t i = from; i < to; ++i) {
+        const GL_Command_t *command = &queue->commands[i];
+        if (command->culled || command->bounds.y1 < y0 || command->bounds.y0 > y1) {
+            continue;
+        }
+        if (command->state != current) {
+            current = command->state;
+            replay.state = queue->states[current];
+            GL_Quad_t *clipping_region = &replay.state.clipping_region;
+            clipping_region->y0 = imax(clipping_region->y0, y0);
+            clipping_region->y1 = imin(clipping_region->y1, y1);
+        }
+        execute(queue, &replay, command);
+    }
+}
+
+static inline bool is_canvas(const GL_Context_t *context, const GL_Surface_t *surface)
+{
+    if (surface == &context->buffer) {
+        return true;
+    }
+    for (size_t i = 0; i < (size_t)arrlen(context->layers); ++i) { // Layers have the same size of the buffer.
+        if (surface == &context->layers[i]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static inline bool reads_canvas(const GL_Context_t *context, const GL_Surface_t *source)
+{
+    if (!source) {
+        return false;
+    }
+    if (GL_surface_aliases(source, &context->buffer)) {
+        return true;
+    }
+    for (size_t i = 0; i < (size_t)arrlen(context->layers); ++i) {
+        if (GL_surface_aliases(source, &context->layers[i])) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Only the commands drawing on the canvas and whose outcome doesn't depend on the clipping region can be split into
+// bands. Clears (which ignore the clipping region), x-form blits (whose scan-line table is indexed by the clipped row),
+// poly-lines (clipped by segment), and blits reading from the canvas (e.g. self-blits, or from a view of a layer, whose
+// rows other bands are writing) act as barriers and are replayed on the calling thread. Views of the canvas, as
+// targets, aren't banded either since their rows are offset from the bands ones.
+static inline bool is_banded(const GL_Queue_t *queue, const GL_Context_t *context, const GL_Command_t *command)
+{
+    const GL_Surface_t *target = queue->states[command->state].surface;
+    if (!is_canvas(context, target) || reads_canvas(context, command->source)) {
+        return false;
+    }
+    return command->type != GL_COMMAND_CLEAR && command->type != GL_COMMAND_BLIT_X && command->type != GL_COMMAND_POLYLINE;
+}
+
+void GL_queue_replay(GL_Queue_t *queue, const GL_Context_t *context)
+{
+    const size_t count = arrlen(queue->commands);
+    if (count == 0) {
+        return;
+    }
+
+    cull(queue);
+    reorder(queue);
+
+    if (!queue->pool) {
+        replay_serial(queue, context, 0, count);
+    } else {
+        for (size_t i = 0; i < count; ) {
+            size_t j = i;
+            while (j < count && is_banded(queue, context, &queue->commands[j])) {
+                ++j;
+            }
+            if (j - i >= GL_QUEUE_MIN_BATCH) { // Waking the workers for a handful of commands isn't worth it.
+                pool_run(queue->pool, queue, context, i, j);
+            } else {
+                replay_serial(queue, context, i, j);
+            }
+            if (j < count) { // Barrier, replayed once all the bands are done.
+                replay_serial(queue, context, j, j + 1);
+                ++j;
+            }
+            i = j;
+        }
+    }
+
+    ARRAY_EMPTY(queue->commands); // Keep the buffers' capacity, to be reused in the next frame.
+    ARRAY_EMPTY(queue->states);
+    ARRAY_EMPTY(queue->vertices);
+    ARRAY_EMPTY(queue->entries);
+}
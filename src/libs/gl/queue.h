@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2019-2020 by Marco Lizza (marco.lizza@gmail.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+#ifndef __GL_QUEUE_H__
+#define __GL_QUEUE_H__
+
+#include "blit.h"
+#include "common.h"
+#include "context.h"
+#include "primitive.h"
+#include "surface.h"
+#include "xform.h"
+
+#include <stdbool.h>
+
+typedef enum _GL_Command_Types_t {
+    GL_COMMAND_CLEAR,
+    GL_COMMAND_BLIT,
+    GL_COMMAND_BLIT_SPANS,
+    GL_COMMAND_BLIT_S,
+    GL_COMMAND_BLIT_SR,
+    GL_COMMAND_BLIT_X,
+    GL_COMMAND_POINT,
+    GL_COMMAND_HLINE,
+    GL_COMMAND_VLINE,
+    GL_COMMAND_POLYLINE,
+    GL_COMMAND_FILLED_RECTANGLE,
+    GL_COMMAND_FILLED_TRIANGLE,
+    GL_COMMAND_FILLED_CIRCLE,
+    GL_COMMAND_CIRCLE,
+    GL_COMMAND_TEXTURED_TRIANGLE,
+    GL_Command_Types_t_CountOf
+} GL_Command_Types_t;
+
+typedef struct _GL_Command_t {
+    GL_Command_Types_t type;
+    size_t state; // Index of the state snapshot the command is to be replayed with.
+    GL_Quad_t bounds; // (Conservative) clipped destination area, used to cull and reorder the commands.
+    const GL_Surface_t *source; // `NULL` for the primitives.
+    bool culled;
+    union {
+        struct {
+            GL_Rectangle_t area;
+            GL_Point_t position;
+        } blit;
+        struct {
+            GL_Spans_t spans;
+            GL_Rectangle_t area;
+            GL_Point_t position;
+        } blit_spans;
+        struct {
+            GL_Rectangle_t area;
+            GL_Point_t position;
+            float scale_x, scale_y;
+        } blit_s;
+        struct {
+            GL_Rectangle_t area;
+            GL_Point_t position;
+            float scale_x, scale_y;
+            int rotation;
+            float anchor_x, anchor_y;
+        } blit_sr;
+        struct {
+            GL_Point_t position;
+            GL_XForm_t xform;
+            size_t table; // Offset of the (copied) scan-line table, if `xform.table` is not `NULL`.
+        } blit_x;
+        struct {
+            GL_Point_t position;
+            size_t length; // Unused for points.
+            GL_Pixel_t index;
+        } line;
+        struct {
+            size_t vertices; // Offset of the (copied) vertices.
+            size_t count;
+            GL_Pixel_t index;
+        } polyline;
+        struct {
+            GL_Rectangle_t rectangle;
+            GL_Pixel_t index;
+        } rectangle;
+        struct {
+            GL_Point_t a, b, c;
+            GL_Pixel_t index;
+        } triangle;
+        struct {
+            GL_Point_t center;
+            int radius;
+            GL_Pixel_t index;
+        } circle;
+        struct {
+            GL_Vertex_t a, b, c;
+        } textured_triangle;
+    } as;
+} GL_Command_t;
+
+struct _GL_Pool_t;
+
+// Per-frame command buffer. State snapshots and variable-length payloads are stored apart from the commands, the
+// former being shared among consecutive commands with the same state.
+//
+// When more than a single worker is requested, the canvas is split into as many horizontal bands, which are
+// rasterized concurrently during the replay (the calling thread takes care of the first band).
+typedef struct _GL_Queue_t {
+    GL_Command_t *commands;
+    GL_State_t *states;
+    GL_Point_t *vertices;
+    GL_XForm_Table_Entry_t *entries;
+    size_t workers;
+    struct _GL_Pool_t *pool;
+} GL_Queue_t;
+
+extern bool GL_queue_create(GL_Queue_t *queue, size_t workers);
+extern void GL_queue_delete(GL_Queue_t *queue);
+
+extern void GL_queue_clear(GL_Queue_t *queue, const GL_State_t *state);
+extern void GL_queue_blit(GL_Queue_t *queue, const GL_State_t *state, const GL_Surface_t *surface, GL_Rectangle_t area, GL_Point_t position);
+extern void GL_queue_blit_spans(GL_Queue_t *queue, const GL_State_t *state, const GL_Surface_t *surface, const GL_Spans_t *spans, GL_Rectangle_t area, GL_Point_t position);
+extern void GL_queue_blit_s(GL_Queue_t *queue, const GL_State_t *state, const GL_Surface_t *surface, GL_Rectangle_t area, GL_Point_t position, float scale_x, float scale_y);
+extern void GL_queue_blit_sr(GL_Queue_t *queue, const GL_State_t *state, const GL_Surface_t *surface, GL_Rectangle_t area, GL_Point_t position, float scale_x, float scale_y, int rotation, float anchor_x, float anchor_y);
+extern void GL_queue_blit_x(GL_Queue_t *queue, const GL_State_t *state, const GL_Surface_t *surface, GL_Point_t position, const GL_XForm_t *xform);
+extern void GL_queue_point(GL_Queue_t *queue, const GL_State_t *state, GL_Point_t position, GL_Pixel_t index);
+extern void GL_queue_hline(GL_Queue_t *queue, const GL_State_t *state, GL_Point_t origin, size_t w, GL_Pixel_t index);
+extern void GL_queue_vline(GL_Queue_t *queue, const GL_State_t *state, GL_Point_t origin, size_t h, GL_Pixel_t index);
+extern void GL_queue_polyline(GL_Queue_t *queue, const GL_State_t *state, const GL_Point_t *vertices, size_t count, GL_Pixel_t index);
+extern void GL_queue_filled_rectangle(GL_Queue_t *queue, const GL_State_t *state, GL_Rectangle_t rectangle, GL_Pixel_t index);
+extern void GL_queue_filled_triangle(GL_Queue_t *queue, const GL_State_t *state, GL_Point_t a, GL_Point_t b, GL_Point_t c, GL_Pixel_t index);
+extern void GL_queue_filled_circle(GL_Queue_t *queue, const GL_State_t *state, GL_Point_t center, int radius, GL_Pixel_t index);
+extern void GL_queue_circle(GL_Queue_t *queue, const GL_State_t *state, GL_Point_t center, int radius, GL_Pixel_t index);
+extern void GL_queue_textured_triangle(GL_Queue_t *queue, const GL_State_t *state, const GL_Surface_t *surface, GL_Vertex_t a, GL_Vertex_t b, GL_Vertex_t c);
+
+extern void GL_queue_replay(GL_Queue_t *queue, const GL_Context_t *context);
+
+#endif  /* __GL_QUEUE_H__ */
@@ -27,6 +27,7 @@
 #include <libs/gl/gl.h>
 #include <libs/stb.h>
 
+#include <math.h>
 #include <stdlib.h>
 
 #define LOG_CONTEXT "sheet"
@@ -53,6 +54,110 @@ GL_Rectangle_t *precompute_cells(size_t width, size_t height, size_t cell_width,
     return cells;
 }
 
+static GL_Trim_t *precompute_trims(const GL_Rectangle_t *cells, size_t count)
+{
+    GL_Trim_t *trims = malloc(count * sizeof(GL_Trim_t));
+    for (size_t i = 0; i < count; ++i) {
+        trims[i] = (GL_Trim_t){
+                .area = cells[i],
+                .offset = (GL_Point_t){ .x = 0, .y = 0 }
+            };
+    }
+    return trims;
+}
+
+// Shrink each cell to the smallest rectangle enclosing its opaque (i.e. non-zero) pixels. As for the spans, this is
+// done only for owned atlases.
+static void trim_cells(GL_Sheet_t *sheet)
+{
+    const GL_Surface_t *atlas = &sheet->atlas;
+    const size_t count = (atlas->width / sheet->size.width) * (atlas->height / sheet->size.height);
+
+    size_t area = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const GL_Rectangle_t *cell = &sheet->cells[i];
+
+        int x0 = (int)cell->width, y0 = (int)cell->height, x1 = -1, y1 = -1;
+        const GL_Pixel_t *sptr = atlas->data + cell->y * atlas->stride + cell->x;
+        for (int y = 0; y < (int)cell->height; ++y) {
+            for (int x = 0; x < (int)cell->width; ++x) {
+                if (sptr[x] == 0) {
+                    continue;
+                }
+                if (x0 > x) {
+                    x0 = x;
+                }
+                if (x1 < x) {
+                    x1 = x;
+                }
+                if (y0 > y) {
+                    y0 = y;
+                }
+                y1 = y;
+            }
+            sptr += atlas->stride;
+        }
+
+        if (x1 < 0) { // Fully transparent cell, mark it as empty.
+            x0 = y0 = 0;
+            x1 = y1 = -1;
+        }
+
+        sheet->trims[i] = (GL_Trim_t){
+                .area = (GL_Rectangle_t){ .x = cell->x + x0, .y = cell->y + y0, .width = x1 - x0 + 1, .height = y1 - y0 + 1 },
+                .offset = (GL_Point_t){ .x = x0, .y = y0 }
+            };
+        area += (x1 - x0 + 1) * (y1 - y0 + 1);
+    }
+    Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "sheet %p trimmed to %d%% of its area", sheet, (int)(area * 100 / (atlas->width * atlas->height)));
+}
+
+// Precompute, for each row of each cell, the list of opaque spans. Only the default transparent index (zero) is
+// considered, which is by far the most common use-case. Spans are built only for atlases owned by the sheet since
+// attached surfaces can be later drawn upon, which would render the spans stale.
+static void precompute_spans(GL_Sheet_t *sheet)
+{
+    const GL_Surface_t *atlas = &sheet->atlas;
+    const size_t count = (atlas->width / sheet->size.width) * (atlas->height / sheet->size.height);
+
+    GL_Span_t *spans = NULL;
+    size_t *rows = malloc((count * sheet->size.height + 1) * sizeof(size_t));
+    if (!rows) {
+        Log_write(LOG_LEVELS_WARNING, LOG_CONTEXT, "can't allocate spans for sheet %p", sheet);
+        return;
+    }
+
+    size_t k = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const GL_Rectangle_t *cell = &sheet->cells[i];
+        const GL_Pixel_t *sptr = atlas->data + cell->y * atlas->stride + cell->x;
+        for (size_t y = 0; y < cell->height; ++y) {
+            rows[k++] = arrlen(spans);
+            for (size_t x = 0; x < cell->width; ) {
+                size_t skip = 0;
+                while ((x < cell->width) && (sptr[x] == 0)) {
+                    ++skip;
+                    ++x;
+                }
+                size_t length = 0;
+                while ((x < cell->width) && (sptr[x] != 0)) {
+                    ++length;
+                    ++x;
+                }
+                if (length > 0) { // Trailing transparent pixels don't need a span.
+                    arrpush(spans, ((GL_Span_t){ .skip = (uint16_t)skip, .count = (uint16_t)length }));
+                }
+            }
+            sptr += atlas->stride;
+        }
+    }
+    rows[k] = arrlen(spans);
+
+    sheet->spans = spans;
+    sheet->rows = rows;
+    Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "sheet %p has %d spans", sheet, (int)arrlen(spans));
+}
+
 bool GL_sheet_decode(GL_Sheet_t *sheet, const void *buffer, size_t size, size_t cell_width, size_t cell_height, GL_Surface_Callback_t callback, void *user_data)
 {
     GL_Surface_t atlas;
@@ -60,6 +165,10 @@ bool GL_sheet_decode(GL_Sheet_t *sheet, const void *buffer, size_t size, size_t
         return false;
     }
     GL_sheet_attach(sheet, &atlas, cell_width, cell_height);
+    trim_cells(sheet);
+#ifdef __GL_SHEET_SPANS__
+    precompute_spans(sheet);
+#endif
     Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "sheet %p decoded", sheet);
     return true;
 }
@@ -71,10 +180,38 @@ bool GL_sheet_fetch(GL_Sheet_t *sheet, GL_Image_t image, size_t cell_width, size
         return false;
     }
     GL_sheet_attach(sheet, &atlas, cell_width, cell_height);
+    trim_cells(sheet);
+#ifdef __GL_SHEET_SPANS__
+    precompute_spans(sheet);
+#endif
     Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "sheet %p decoded", sheet);
     return true;
 }
 
+// As `GL_sheet_fetch()`, but the atlas is packed into a shared page. The sheet owns everything but the pixels, and is
+// to be deleted with `GL_sheet_unpack()`.
+bool GL_sheet_pack(GL_Sheet_t *sheet, GL_Atlas_t *atlas, GL_Image_t image, size_t cell_width, size_t cell_height, const GL_Surface_Callback_t callback, void *user_data)
+{
+    GL_Surface_t surface;
+    if (!GL_atlas_fetch(atlas, &surface, image, callback, user_data)) {
+        return false;
+    }
+    GL_sheet_attach(sheet, &surface, cell_width, cell_height);
+    trim_cells(sheet);
+#ifdef __GL_SHEET_SPANS__
+    precompute_spans(sheet);
+#endif
+    Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "sheet %p packed", sheet);
+    return true;
+}
+
+void GL_sheet_unpack(GL_Sheet_t *sheet, GL_Atlas_t *atlas)
+{
+    GL_atlas_release(atlas, &sheet->atlas);
+    GL_sheet_detach(sheet);
+    Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "sheet %p unpacked", sheet);
+}
+
 void GL_sheet_delete(GL_Sheet_t *sheet)
 {
     GL_surface_delete(&sheet->atlas); // Delete prior detach or the atlas will be cleared!
@@ -84,9 +221,11 @@ void GL_sheet_delete(GL_Sheet_t *sheet)
 
 void GL_sheet_attach(GL_Sheet_t *sheet, const GL_Surface_t *atlas, size_t cell_width, size_t cell_height)
 {
+    GL_Rectangle_t *cells = precompute_cells(atlas->width, atlas->height, cell_width, cell_height);
     *sheet = (GL_Sheet_t){
             .atlas = *atlas,
-            .cells = precompute_cells(atlas->width, atlas->height, cell_width, cell_height),
+            .cells = cells,
+            .trims = precompute_trims(cells, (atlas->width / cell_width) * (atlas->height / cell_height)),
             .size = (GL_Size_t){ cell_width, cell_height }
         };
     Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "sheet %p attached", sheet);
@@ -94,6 +233,75 @@ void GL_sheet_attach(GL_Sheet_t *sheet, const GL_Surface_t *atlas, size_t cell_w
 
 void GL_sheet_detach(GL_Sheet_t *sheet)
 {
+    arrfree(sheet->spans);
+    free(sheet->rows);
+    free(sheet->trims);
     free(sheet->cells);
     Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "sheet %p detached", sheet);
 }
+
+// Trimmed borders are made of index zero pixels, they can be skipped as long as the index remains transparent.
+static inline bool _is_trimmable(const GL_State_t *state)
+{
+    return state->transparent[state->shifting[0]];
+}
+
+// Spans are valid only for identity shifting and when index zero alone is transparent.
+static inline bool _is_default_state(const GL_State_t *state)
+{
+    const GL_Fingerprint_t *fingerprint = &state->fingerprint;
+    return fingerprint->identity && fingerprint->transparent == 1 && fingerprint->keys[0] == 0 && !fingerprint->masked && !fingerprint->blended && !fingerprint->shaded;
+}
+
+void GL_sheet_blit(const GL_Context_t *context, const GL_Sheet_t *sheet, size_t cell_id, GL_Point_t position)
+{
+    const GL_State_t *state = &context->state;
+    if (!_is_trimmable(state)) {
+        GL_context_blit(context, &sheet->atlas, sheet->cells[cell_id], position);
+        return;
+    }
+
+    const GL_Trim_t *trim = &sheet->trims[cell_id];
+    if (sheet->rows && _is_default_state(state)) { // Spans are relative to the cell left edge, trim vertically only.
+        const GL_Rectangle_t *cell = &sheet->cells[cell_id];
+        GL_Spans_t spans = (GL_Spans_t){
+                .spans = sheet->spans,
+                .rows = sheet->rows + cell_id * sheet->size.height + trim->offset.y
+            };
+        GL_context_blit_spans(context, &sheet->atlas, &spans,
+            (GL_Rectangle_t){ .x = cell->x, .y = trim->area.y, .width = cell->width, .height = trim->area.height },
+            (GL_Point_t){ .x = position.x, .y = position.y + trim->offset.y });
+    } else {
+        GL_context_blit(context, &sheet->atlas, trim->area, (GL_Point_t){ .x = position.x + trim->offset.x, .y = position.y + trim->offset.y });
+    }
+}
+
+// The trimmed offset is scaled (and mirrored, when flipping) too. This is exact only for integer scaling factors,
+// where each texel is replicated a fixed amount of times; fractional ones would sample the trimmed area with a
+// different phase than the whole cell, so the latter is drawn in that case.
+void GL_sheet_blit_s(const GL_Context_t *context, const GL_Sheet_t *sheet, size_t cell_id, GL_Point_t position, float scale_x, float scale_y)
+{
+    if (!_is_trimmable(&context->state) || (float)(int)scale_x != scale_x || (float)(int)scale_y != scale_y) {
+        GL_context_blit_s(context, &sheet->atlas, sheet->cells[cell_id], position, scale_x, scale_y);
+        return;
+    }
+
+    const GL_Trim_t *trim = &sheet->trims[cell_id];
+    if (trim->area.width == 0) { // Nothing to draw, bail out.
+        return;
+    }
+
+    const int offset_x = scale_x < 0.0f ? (int)sheet->size.width - (trim->offset.x + (int)trim->area.width) : trim->offset.x;
+    const int offset_y = scale_y < 0.0f ? (int)sheet->size.height - (trim->offset.y + (int)trim->area.height) : trim->offset.y;
+    GL_context_blit_s(context, &sheet->atlas, trim->area, (GL_Point_t){
+            .x = position.x + offset_x * abs((int)scale_x),
+            .y = position.y + offset_y * abs((int)scale_y)
+        }, scale_x, scale_y);
+}
+
+// The texture coordinates depend (by rounding) on the transformed area, so the trimmed one would sample the cell with
+// a slightly different phase. The whole cell is always drawn, rotated cells are better served by the cache anyway.
+void GL_sheet_blit_sr(const GL_Context_t *context, const GL_Sheet_t *sheet, size_t cell_id, GL_Point_t position, float scale_x, float scale_y, int rotation, float anchor_x, float anchor_y)
+{
+    GL_context_blit_sr(context, &sheet->atlas, sheet->cells[cell_id], position, scale_x, scale_y, rotation, anchor_x, anchor_y);
+}
@@ -25,22 +25,39 @@
 
 #include <stdbool.h>
 
+#include "atlas.h"
+#include "blit.h"
 #include "common.h"
+#include "context.h"
 #include "surface.h"
 
+typedef struct _GL_Trim_t {
+    GL_Rectangle_t area; // Opaque area of the cell, into the atlas (empty when the cell is fully transparent).
+    GL_Point_t offset; // Position of the opaque area relative to the cell top-left corner.
+} GL_Trim_t;
+
 typedef struct _GL_Sheet_t {
     GL_Surface_t atlas;
     GL_Rectangle_t *cells;
+    GL_Trim_t *trims; // Same as `cells` (i.e. no trimming) unless the atlas is owned.
     GL_Size_t size;
+    GL_Span_t *spans; // Opaque spans of each cell (for the default state), present only when the atlas is owned.
+    size_t *rows; // Per-cell-row offsets into `spans`, i.e. `cells * size.height + 1` entries.
 } GL_Sheet_t;
 
 // TODO: is the GL_Sheet_t really needed?
 
 extern bool GL_sheet_decode(GL_Sheet_t *sheet, const void *buffer, size_t size, size_t cell_width, size_t cell_height, GL_Surface_Callback_t callback, void *user_data);
 extern bool GL_sheet_fetch(GL_Sheet_t *sheet, GL_Image_t image, size_t cell_width, size_t cell_height, const GL_Surface_Callback_t callback, void *user_data);
+extern bool GL_sheet_pack(GL_Sheet_t *sheet, GL_Atlas_t *atlas, GL_Image_t image, size_t cell_width, size_t cell_height, const GL_Surface_Callback_t callback, void *user_data);
+extern void GL_sheet_unpack(GL_Sheet_t *sheet, GL_Atlas_t *atlas);
 extern void GL_sheet_delete(GL_Sheet_t *sheet);
 extern void GL_sheet_attach(GL_Sheet_t *sheet, const GL_Surface_t *atlas, size_t cell_width, size_t cell_height);
 extern void GL_sheet_detach(GL_Sheet_t *sheet);
 
+extern void GL_sheet_blit(const GL_Context_t *context, const GL_Sheet_t *sheet, size_t cell_id, GL_Point_t position);
+extern void GL_sheet_blit_s(const GL_Context_t *context, const GL_Sheet_t *sheet, size_t cell_id, GL_Point_t position, float scale_x, float scale_y);
+extern void GL_sheet_blit_sr(const GL_Context_t *context, const GL_Sheet_t *sheet, size_t cell_id, GL_Point_t position, float scale_x, float scale_y, int rotation, float anchor_x, float anchor_y);
+
 
 #endif  /* __GL_SHEET_H__ */
\ No newline at end of file
@@ -0,0 +1,204 @@
+/*
+ * Copyright (c) 2019-2020 by Marco Lizza (marco.lizza@gmail.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+#include "simd.h"
+
+#include <config.h>
+#include <libs/log.h>
+
+#include "palette.h"
+
+#include <string.h>
+
+#if defined(__GL_SIMD_KERNELS__) && defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+  #define __GL_SIMD_X86__
+  #include <immintrin.h>
+#endif
+
+#define LOG_CONTEXT "gl"
+
+typedef void (*Copy_Function_t)(GL_Pixel_t *dst, const GL_Pixel_t *src, size_t count, const GL_Pixel_t *keys, size_t keys_count);
+
+typedef struct _Kernels_t {
+    const char *name;
+    Copy_Function_t copy;
+} Kernels_t;
+
+static GL_Pixel_t _identity[GL_MAX_PALETTE_COLORS];
+
+// The scalar kernels are both the fallback for non-x86 architectures (e.g. the Raspberry-Pi) and
+// the tail handlers for the vectorized ones.
+static void copy_scalar(GL_Pixel_t *dst, const GL_Pixel_t *src, size_t count, const GL_Pixel_t *keys, size_t keys_count)
+{
+    if (keys_count == 0) {
+        memcpy(dst, src, count);
+    } else
+    if (keys_count == 1) {
+        const GL_Pixel_t key = keys[0];
+        for (size_t i = count; i; --i) {
+            GL_Pixel_t index = *(src++);
+            if (index != key) {
+                *dst = index;
+            }
+            ++dst;
+        }
+    } else {
+        for (size_t i = count; i; --i) {
+            GL_Pixel_t index = *(src++);
+            bool transparent = false;
+            for (size_t k = 0; k < keys_count; ++k) {
+                transparent |= index == keys[k];
+            }
+            if (!transparent) {
+                *dst = index;
+            }
+            ++dst;
+        }
+    }
+}
+
+#ifdef __GL_SIMD_X86__
+// Each pixel is compared against the transparent indexes (*keys*), building a byte-mask that is
+// used to merge the source and destination pixels. Whole vectors that are fully opaque or fully
+// transparent don't need the (read-modify-write) merge.
+__attribute__((target("sse2")))
+static void copy_sse2(GL_Pixel_t *dst, const GL_Pixel_t *src, size_t count, const GL_Pixel_t *keys, size_t keys_count)
+{
+    if (keys_count == 0) {
+        memcpy(dst, src, count);
+        return;
+    }
+
+    __m128i k[GL_SIMD_MAX_KEYS];
+    for (size_t i = 0; i < keys_count; ++i) {
+        k[i] = _mm_set1_epi8((char)keys[i]);
+    }
+
+    for (; count >= 16; count -= 16) {
+        const __m128i s = _mm_loadu_si128((const __m128i *)src);
+        __m128i m = _mm_cmpeq_epi8(s, k[0]);
+        for (size_t i = 1; i < keys_count; ++i) {
+            m = _mm_or_si128(m, _mm_cmpeq_epi8(s, k[i]));
+        }
+        const int bits = _mm_movemask_epi8(m);
+        if (bits == 0x0000) {
+            _mm_storeu_si128((__m128i *)dst, s);
+        } else
+        if (bits != 0xFFFF) {
+            const __m128i d = _mm_loadu_si128((const __m128i *)dst);
+            _mm_storeu_si128((__m128i *)dst, _mm_or_si128(_mm_and_si128(m, d), _mm_andnot_si128(m, s)));
+        }
+        src += 16;
+        dst += 16;
+    }
+
+    copy_scalar(dst, src, count, keys, keys_count);
+}
+
+__attribute__((target("avx2")))
+static void copy_avx2(GL_Pixel_t *dst, const GL_Pixel_t *src, size_t count, const GL_Pixel_t *keys, size_t keys_count)
+{
+    if (keys_count == 0) {
+        memcpy(dst, src, count);
+        return;
+    }
+
+    __m256i k[GL_SIMD_MAX_KEYS];
+    for (size_t i = 0; i < keys_count; ++i) {
+        k[i] = _mm256_set1_epi8((char)keys[i]);
+    }
+
+    for (; count >= 32; count -= 32) {
+        const __m256i s = _mm256_loadu_si256((const __m256i *)src);
+        __m256i m = _mm256_cmpeq_epi8(s, k[0]);
+        for (size_t i = 1; i < keys_count; ++i) {
+            m = _mm256_or_si256(m, _mm256_cmpeq_epi8(s, k[i]));
+        }
+        const int bits = _mm256_movemask_epi8(m);
+        if (bits == 0) {
+            _mm256_storeu_si256((__m256i *)dst, s);
+        } else
+        if (bits != -1) {
+            const __m256i d = _mm256_loadu_si256((const __m256i *)dst);
+            _mm256_storeu_si256((__m256i *)dst, _mm256_blendv_epi8(s, d, m));
+        }
+        src += 32;
+        dst += 32;
+    }
+
+    copy_sse2(dst, src, count, keys, keys_count); // AVX2 implies SSE2, finish with narrower vectors.
+}
+#endif
+
+static const Kernels_t _kernels_scalar = { "scalar", copy_scalar };
+#ifdef __GL_SIMD_X86__
+static const Kernels_t _kernels_sse2 = { "SSE2", copy_sse2 };
+static const Kernels_t _kernels_avx2 = { "AVX2", copy_avx2 };
+#endif
+
+static const Kernels_t *_kernels = &_kernels_scalar;
+
+void GL_simd_initialize(void)
+{
+    for (size_t i = 0; i < GL_MAX_PALETTE_COLORS; ++i) {
+        _identity[i] = (GL_Pixel_t)i;
+    }
+
+#ifdef __GL_SIMD_X86__
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        _kernels = &_kernels_avx2;
+    } else
+    if (__builtin_cpu_supports("sse2")) {
+        _kernels = &_kernels_sse2;
+    }
+#endif
+
+    Log_write(LOG_LEVELS_INFO, LOG_CONTEXT, "using %s kernels", _kernels->name);
+}
+
+bool GL_simd_identity(const GL_Pixel_t *shifting)
+{
+    return memcmp(shifting, _identity, sizeof(_identity)) == 0;
+}
+
+// Collects the transparent indexes, bailing out as soon as there are too many of them. In that case
+// `GL_SIMD_MAX_KEYS + 1` is returned, and the caller should use the (generic) table-driven kernel.
+size_t GL_simd_keys(const GL_Bool_t *transparent, GL_Pixel_t *keys)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < GL_MAX_PALETTE_COLORS; ++i) {
+        if (!transparent[i]) {
+            continue;
+        }
+        if (count == GL_SIMD_MAX_KEYS) {
+            return GL_SIMD_MAX_KEYS + 1;
+        }
+        keys[count++] = (GL_Pixel_t)i;
+    }
+    return count;
+}
+
+void GL_simd_copy(GL_Pixel_t *dst, const GL_Pixel_t *src, size_t count, const GL_Pixel_t *keys, size_t keys_count)
+{
+    _kernels->copy(dst, src, count, keys, keys_count);
+}
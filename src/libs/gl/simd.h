@@ -0,0 +1,39 @@
+/*
+ * Copyright (c) 2019-2020 by Marco Lizza (marco.lizza@gmail.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+#ifndef __GL_SIMD_H__
+#define __GL_SIMD_H__
+
+#include <stdbool.h>
+
+#include "common.h"
+
+#define GL_SIMD_MAX_KEYS    4
+
+extern void GL_simd_initialize(void);
+
+extern bool GL_simd_identity(const GL_Pixel_t *shifting);
+extern size_t GL_simd_keys(const GL_Bool_t *transparent, GL_Pixel_t *keys);
+
+extern void GL_simd_copy(GL_Pixel_t *dst, const GL_Pixel_t *src, size_t count, const GL_Pixel_t *keys, size_t keys_count);
+
+#endif  /* __GL_SIMD_H__ */
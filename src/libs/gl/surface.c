@@ -23,10 +23,14 @@
 #include "surface.h"
 
 #include <config.h>
+#include <libs/imath.h>
 #include <libs/log.h>
 #include <libs/gl/gl.h>
 #include <libs/stb.h>
 
+#include <stdlib.h>
+#include <string.h>
+
 #define LOG_CONTEXT "gl"
 
 bool GL_surface_decode(GL_Surface_t *surface, const void *buffer, size_t buffer_size, const GL_Surface_Callback_t callback, void *user_data)
@@ -64,20 +68,26 @@ bool GL_surface_fetch(GL_Surface_t *surface, GL_Image_t image, const GL_Surface_
     return true;
 }
 
+// Rows are allocated with a stride padded to `GL_SURFACE_ALIGNMENT`, and the data pointer is aligned to it, so that
+// each row starts on an aligned address (which is what the SIMD and `memcpy()` based row helpers like best).
 bool GL_surface_create(GL_Surface_t *surface, size_t width, size_t height)
 {
-    GL_Pixel_t *data = malloc(width * height * sizeof(GL_Pixel_t));
-    if (!data) {
+    const size_t stride = (width + GL_SURFACE_ALIGNMENT - 1) & ~(size_t)(GL_SURFACE_ALIGNMENT - 1);
+    void *memory = malloc(stride * height * sizeof(GL_Pixel_t) + GL_SURFACE_ALIGNMENT - 1);
+    if (!memory) {
         return false;
     }
+    GL_Pixel_t *data = (GL_Pixel_t *)(((uintptr_t)memory + GL_SURFACE_ALIGNMENT - 1) & ~(uintptr_t)(GL_SURFACE_ALIGNMENT - 1));
 
-    Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "surface created at %p (%dx%d)", data, width, height);
+    Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "surface created at %p (%dx%d, stride %d)", data, width, height, stride);
 
     *surface = (GL_Surface_t){
             .width = width,
             .height = height,
+            .stride = stride,
             .data = data,
-            .data_size = width * height
+            .data_size = stride * height,
+            .memory = memory
         };
 
     return true;
@@ -85,32 +95,181 @@ bool GL_surface_create(GL_Surface_t *surface, size_t width, size_t height)
 
 void GL_surface_delete(GL_Surface_t *surface)
 {
-    free(surface->data);
+    if (!surface->memory) { // Views borrow both the pixels and the row flags.
+        Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "view at %p released", surface->data);
+        return;
+    }
+    free(surface->dirty);
+    free(surface->memory);
     Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "surface at %p deleted", surface->data);
 }
 
+// A view is a (zero-copy) sub-rectangle of another surface, sharing its pixels and, when tracked, its row flags. It
+// can be both used as a drawing target and a source, and must not outlive the surface it refers to. The area is
+// clipped to the surface, failing when nothing remains.
+bool GL_surface_view(GL_Surface_t *view, const GL_Surface_t *surface, GL_Rectangle_t area)
+{
+    int x0 = imax(area.x, 0);
+    int y0 = imax(area.y, 0);
+    int x1 = imin(area.x + area.width, (int)surface->width);
+    int y1 = imin(area.y + area.height, (int)surface->height);
+    if (x0 >= x1 || y0 >= y1) {
+        Log_write(LOG_LEVELS_WARNING, LOG_CONTEXT, "view area <%d, %d, %d, %d> is outside surface %p", area.x, area.y, area.width, area.height, surface->data);
+        return false;
+    }
+
+    const size_t width = (size_t)(x1 - x0);
+    const size_t height = (size_t)(y1 - y0);
+
+    *view = (GL_Surface_t){
+            .width = width,
+            .height = height,
+            .stride = surface->stride,
+            .data = surface->data + y0 * surface->stride + x0,
+            .data_size = (height - 1) * surface->stride + width,
+            .memory = NULL,
+            .dirty = surface->dirty ? surface->dirty + y0 : NULL
+        };
+
+    Log_write(LOG_LEVELS_DEBUG, LOG_CONTEXT, "view at %p created on surface %p (%dx%d)", view->data, surface->data, width, height);
+
+    return true;
+}
+
+// Tells whether the two surfaces share (some of) their pixels, which is the case for a surface and its views. The
+// storage extents are compared, so that two views interleaved on the same rows are conservatively reported too.
+bool GL_surface_aliases(const GL_Surface_t *a, const GL_Surface_t *b)
+{
+    if (a == b) {
+        return true;
+    }
+    return a->data < b->data + b->data_size && b->data < a->data + a->data_size;
+}
+
+// Tracked surfaces keep a flag for each row, set by the drawing operations that change it and cleared by the
+// consumer (e.g. the layers composition). The flags start all set, the content being yet to be consumed.
+bool GL_surface_track(GL_Surface_t *surface, bool enabled)
+{
+    if (!surface->memory) {
+        Log_write(LOG_LEVELS_WARNING, LOG_CONTEXT, "can't change tracking of view %p", surface->data);
+        return false;
+    }
+    if (enabled && !surface->dirty) {
+        GL_Bool_t *dirty = malloc(surface->height * sizeof(GL_Bool_t));
+        if (!dirty) {
+            Log_write(LOG_LEVELS_ERROR, LOG_CONTEXT, "can't allocate rows flags for surface %p", surface->data);
+            return false;
+        }
+        memset(dirty, GL_BOOL_TRUE, surface->height * sizeof(GL_Bool_t));
+        surface->dirty = dirty;
+    } else
+    if (!enabled && surface->dirty) {
+        free(surface->dirty);
+        surface->dirty = NULL;
+    }
+    return true;
+}
+
+// Mark the `[y0, y1]` rows as changed, clamping them to the surface. Being the rows disjoint, the banded replay can
+// safely call this concurrently.
+void GL_surface_touch(const GL_Surface_t *surface, int y0, int y1)
+{
+    if (!surface->dirty) {
+        return;
+    }
+    if (y0 < 0) {
+        y0 = 0;
+    }
+    if (y1 > (int)surface->height - 1) {
+        y1 = (int)surface->height - 1;
+    }
+    if (y0 > y1) {
+        return;
+    }
+    memset(surface->dirty + y0, GL_BOOL_TRUE, (size_t)(y1 - y0 + 1) * sizeof(GL_Bool_t));
+}
+
+// Copy the area pixels into the (tightly packed, `area.width` pixels per row) buffer. Pixels outside the surface read
+// as zero.
+void GL_surface_read(const GL_Surface_t *surface, GL_Rectangle_t area, GL_Pixel_t *pixels)
+{
+    const int x0 = imax(area.x, 0);
+    const int y0 = imax(area.y, 0);
+    const int x1 = imin(area.x + (int)area.width, (int)surface->width);
+    const int y1 = imin(area.y + (int)area.height, (int)surface->height);
+    if (x0 != area.x || y0 != area.y || x1 != area.x + (int)area.width || y1 != area.y + (int)area.height) {
+        memset(pixels, 0, area.width * area.height * sizeof(GL_Pixel_t));
+    }
+    if (x0 >= x1 || y0 >= y1) {
+        return;
+    }
+
+    const size_t width = (size_t)(x1 - x0);
+    const GL_Pixel_t *sptr = surface->data + y0 * surface->stride + x0;
+    GL_Pixel_t *dptr = pixels + (y0 - area.y) * area.width + (x0 - area.x);
+    for (int i = y1 - y0; i; --i) {
+        memcpy(dptr, sptr, width * sizeof(GL_Pixel_t));
+        sptr += surface->stride;
+        dptr += area.width;
+    }
+}
+
+// Copy the (tightly packed) buffer pixels into the area. Pixels falling outside the surface are discarded.
+void GL_surface_write(const GL_Surface_t *surface, GL_Rectangle_t area, const GL_Pixel_t *pixels)
+{
+    const int x0 = imax(area.x, 0);
+    const int y0 = imax(area.y, 0);
+    const int x1 = imin(area.x + (int)area.width, (int)surface->width);
+    const int y1 = imin(area.y + (int)area.height, (int)surface->height);
+    if (x0 >= x1 || y0 >= y1) {
+        return;
+    }
+
+    const size_t width = (size_t)(x1 - x0);
+    const GL_Pixel_t *sptr = pixels + (y0 - area.y) * area.width + (x0 - area.x);
+    GL_Pixel_t *dptr = surface->data + y0 * surface->stride + x0;
+    for (int i = y1 - y0; i; --i) {
+        memcpy(dptr, sptr, width * sizeof(GL_Pixel_t));
+        sptr += area.width;
+        dptr += surface->stride;
+    }
+
+    GL_surface_touch(surface, y0, y1 - 1);
+}
+
 void GL_surface_to_rgba(const GL_Surface_t *surface, const GL_Palette_t *palette, GL_Color_t *vram)
 {
-    const int data_size = surface->data_size;
+    GL_surface_rows_to_rgba(surface, palette, 0, surface->height - 1, vram);
+}
+
+// Convert the `[y0, y1]` rows only, storing them at the same offset in the VRAM buffer (which is sized after the
+// whole surface, with no rows padding).
+void GL_surface_rows_to_rgba(const GL_Surface_t *surface, const GL_Palette_t *palette, size_t y0, size_t y1, GL_Color_t *vram)
+{
+    const size_t width = surface->width;
+    const size_t skip = surface->stride - width;
     const GL_Color_t *colors = palette->colors;
 #ifdef __DEBUG_GRAPHICS__
     int count = palette->count;
 #endif
-    const GL_Pixel_t *src = surface->data;
-    GL_Color_t *dst = vram;
-    for (int i = data_size; i; --i) {
-        GL_Pixel_t index = *src++;
+    const GL_Pixel_t *src = surface->data + y0 * surface->stride;
+    GL_Color_t *dst = vram + y0 * width;
+    for (size_t rows = y1 - y0 + 1; rows; --rows) {
+        for (size_t i = width; i; --i) {
+            GL_Pixel_t index = *src++;
 #ifdef __DEBUG_GRAPHICS__
-        GL_Color_t color;
-        if (index >= count) {
-            int y = (index - 240) * 8;
-            color = (GL_Color_t){ 0, 63 + y, 0, 255 };
-        } else {
-            color = colors[index];
-        }
-        *(dst++) = color;
+            GL_Color_t color;
+            if (index >= count) {
+                int y = (index - 240) * 8;
+                color = (GL_Color_t){ 0, 63 + y, 0, 255 };
+            } else {
+                color = colors[index];
+            }
+            *(dst++) = color;
 #else
-        *(dst++) = colors[index];
+            *(dst++) = colors[index];
 #endif
+        }
+        src += skip;
     }
 }
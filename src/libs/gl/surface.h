@@ -28,10 +28,16 @@
 #include "common.h"
 #include "palette.h"
 
+// Rows are padded so that each of them starts at an address multiple of this (in bytes).
+#define GL_SURFACE_ALIGNMENT    32
+
 typedef struct _GL_Surface_t {
     size_t width, height;
+    size_t stride; // Pixels between the start of two consecutive rows, always use this when stepping from row to row.
     GL_Pixel_t *data;
-    size_t data_size;
+    size_t data_size; // Addressable pixels, starting from `data` (rows padding included).
+    void *memory; // Owned allocation, `NULL` for views (see `GL_surface_view()`).
+    GL_Bool_t *dirty; // Per-row change flags, `NULL` when the surface isn't tracked (see `GL_surface_track()`).
 } GL_Surface_t;
 
 typedef void (*GL_Surface_Callback_t)(void *user_data, GL_Surface_t *surface, const void *data);
@@ -40,7 +46,14 @@ extern bool GL_surface_decode(GL_Surface_t *surface, const void *buffer, size_t
 extern bool GL_surface_fetch(GL_Surface_t *surface, GL_Image_t image, const GL_Surface_Callback_t callback, void *user_data);
 extern bool GL_surface_create(GL_Surface_t *surface, size_t width, size_t height);
 extern void GL_surface_delete(GL_Surface_t *surface);
+extern bool GL_surface_view(GL_Surface_t *view, const GL_Surface_t *surface, GL_Rectangle_t area);
+extern bool GL_surface_aliases(const GL_Surface_t *a, const GL_Surface_t *b);
+extern bool GL_surface_track(GL_Surface_t *surface, bool enabled);
+extern void GL_surface_touch(const GL_Surface_t *surface, int y0, int y1);
+extern void GL_surface_read(const GL_Surface_t *surface, GL_Rectangle_t area, GL_Pixel_t *pixels);
+extern void GL_surface_write(const GL_Surface_t *surface, GL_Rectangle_t area, const GL_Pixel_t *pixels);
 
 extern void GL_surface_to_rgba(const GL_Surface_t *context, const GL_Palette_t *palette, GL_Color_t *vram);
+extern void GL_surface_rows_to_rgba(const GL_Surface_t *surface, const GL_Palette_t *palette, size_t y0, size_t y1, GL_Color_t *vram);
 
 #endif  /* __GL_SURFACE_H__ */
\ No newline at end of file